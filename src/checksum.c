@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "globals.h"
+#include "checksum.h"
+
+// the reflected Castagnoli polynomial
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+static uint32_t crc32c_table[256];
+static bool crc32c_table_ready = false;
+
+// function to compute the checksum a byte at a time, for CPUs without
+// the crc32 instruction
+static uint32_t crc32c_software(uint32_t crc, const uint8_t* data, size_t length)
+{
+    if (!crc32c_table_ready)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t entry = i;
+            for (uint32_t bit = 0; bit < 8; bit++)
+            {
+                entry = (entry >> 1) ^ (CRC32C_POLYNOMIAL & -(entry & 1));
+            }
+            crc32c_table[i] = entry;
+        }
+        crc32c_table_ready = true;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ data[i]) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+// function to compute the checksum 8 bytes at a time with SSE4.2. The
+// target attribute lets this one function use the instruction without
+// building the whole program for SSE4.2.
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hardware(uint32_t crc, const uint8_t* data, size_t length)
+{
+    uint64_t crc64 = crc;
+    while (length >= sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+
+    crc = (uint32_t)crc64;
+    while (length > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+        data += 1;
+        length -= 1;
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(const void* data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return ~crc32c_hardware(crc, data, length);
+    }
+#endif
+
+    return ~crc32c_software(crc, data, length);
+}
@@ -0,0 +1,17 @@
+/*
+ * CHECKSUM
+ * -----------
+ *  This file contains the CRC32C (Castagnoli) checksum used to detect
+ *  corrupted pages. It uses the SSE4.2 crc32 instruction when the CPU
+ *  has it, and falls back to a lookup table otherwise.
+ */
+#ifndef checksum_h
+#define checksum_h
+
+#include <stddef.h>
+
+#include "globals.h"
+
+uint32_t crc32c(const void* data, size_t length);
+
+#endif
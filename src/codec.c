@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "codec.h"
+
+// the layout of the default table (see db_open)
+//  id          integer
+//  username    varchar(32)
+//  email       varchar(255)
+#define USERS_ID_OFFSET 0
+#define USERS_USERNAME_OFFSET (USERS_ID_OFFSET + INT_COLUMN_SIZE)
+#define USERS_EMAIL_OFFSET (USERS_USERNAME_OFFSET + COLUMN_USERNAME_SIZE + 1)
+#define USERS_ROW_SIZE (USERS_EMAIL_OFFSET + COLUMN_EMAIL_SIZE + 1)
+
+// function to lay the values of an insert out in a row of any schema,
+// exactly as they'll sit on the page
+static StatementPreparationOutcomes generic_encode(Schema* schema, char** values, Row* row)
+{
+    memset(row->data, 0, schema->row_size);
+
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        Column* column = &(schema->columns[i]);
+
+        if (column->type == COLUMN_INT)
+        {
+            int value = atoi(values[i]);
+            if (value < 0)
+            {
+                return PREPARE_NEGATIVE_ID;
+            }
+            uint32_t stored_value = value;
+            memcpy(row->data + column->offset, &stored_value, INT_COLUMN_SIZE);
+        }
+        else
+        {
+            // leave room for the null terminator
+            if (strlen(values[i]) > column->size - 1)
+            {
+                return PREPARE_STRING_TOO_LONG;
+            }
+            strcpy((char*)(row->data + column->offset), values[i]);
+        }
+    }
+
+    return PREPARE_SUCCESS;
+}
+
+// function to print a row of any schema, given where it lives in memory
+static void generic_print(Schema* schema, void* row)
+{
+    printf("(");
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        Column* column = &(schema->columns[i]);
+        if (i > 0)
+        {
+            printf(", ");
+        }
+
+        if (column->type == COLUMN_INT)
+        {
+            uint32_t value;
+            memcpy(&value, row + column->offset, INT_COLUMN_SIZE);
+            printf("%d", value);
+        }
+        else
+        {
+            printf("%s", (char*)(row + column->offset));
+        }
+    }
+    printf(")\n");
+}
+
+// the same two functions for the default table's layout. With every
+// offset and size known up front, there's no loop over the columns
+// and the whole row is printed with a single printf.
+static StatementPreparationOutcomes users_encode(Schema* schema, char** values, Row* row)
+{
+    int id = atoi(values[0]);
+    if (id < 0)
+    {
+        return PREPARE_NEGATIVE_ID;
+    }
+    if (strlen(values[1]) > COLUMN_USERNAME_SIZE || strlen(values[2]) > COLUMN_EMAIL_SIZE)
+    {
+        return PREPARE_STRING_TOO_LONG;
+    }
+
+    memset(row->data, 0, USERS_ROW_SIZE);
+    uint32_t stored_id = id;
+    memcpy(row->data + USERS_ID_OFFSET, &stored_id, INT_COLUMN_SIZE);
+    strcpy((char*)(row->data + USERS_USERNAME_OFFSET), values[1]);
+    strcpy((char*)(row->data + USERS_EMAIL_OFFSET), values[2]);
+    return PREPARE_SUCCESS;
+}
+
+static void users_print(Schema* schema, void* row)
+{
+    uint32_t id;
+    memcpy(&id, row + USERS_ID_OFFSET, INT_COLUMN_SIZE);
+    printf("(%d, %s, %s)\n", id, (char*)(row + USERS_USERNAME_OFFSET), (char*)(row + USERS_EMAIL_OFFSET));
+}
+
+// indexed by RowCodecKind
+static const RowCodec row_codecs[] = {
+    {generic_encode, generic_print},
+    {users_encode, users_print},
+};
+
+// function to pick the codec for a schema. Any table laid out like the
+// default one gets its specialized codec, whatever its columns are named.
+RowCodecKind row_codec_select(Schema* schema)
+{
+    Column* columns = schema->columns;
+
+    if (schema->column_count == 3 &&
+            columns[0].type == COLUMN_INT &&
+            columns[1].type == COLUMN_TEXT && columns[1].size == COLUMN_USERNAME_SIZE + 1 &&
+            columns[2].type == COLUMN_TEXT && columns[2].size == COLUMN_EMAIL_SIZE + 1)
+    {
+        return ROW_CODEC_USERS;
+    }
+    return ROW_CODEC_GENERIC;
+}
+
+// function to get the codec chosen for a schema
+const RowCodec* row_codec(Schema* schema)
+{
+    return &(row_codecs[schema->codec]);
+}
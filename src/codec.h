@@ -0,0 +1,20 @@
+/*
+ * CODEC
+ * -----------
+ *  This file contains the row codecs: the functions that turn the
+ *  values of an insert into a row, and a row back into text.
+ *  1. A generic codec that walks the columns of any schema
+ *  2. Codecs specialized for a fixed layout, where every offset and
+ *     size is a compile-time constant
+ *  3. Choosing the codec for a schema, once, when its table is
+ *     created or the database is opened
+ */
+#ifndef codec_h
+#define codec_h
+
+#include "globals.h"
+
+RowCodecKind row_codec_select(Schema* schema);
+const RowCodec* row_codec(Schema* schema);
+
+#endif
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "columnar.h"
+
+// every message starts with this marker, followed by the length of
+// its metadata, the metadata and then the body
+#define MESSAGE_CONTINUATION 0xFFFFFFFF
+#define MESSAGE_SCHEMA 1
+#define MESSAGE_RECORD_BATCH 2
+
+// column types, numbered as in Arrow's Type enum
+#define COLUMNAR_TYPE_INT 2
+#define COLUMNAR_TYPE_UTF8 5
+
+// metadata and buffers are padded to 8 bytes, so readers can use
+// them in place
+#define COLUMNAR_ALIGNMENT 8
+#define align_to(Length, Alignment) (((Length) + (Alignment) - 1) / (Alignment) * (Alignment))
+
+// the most metadata a message can have: a schema with every column
+// name at its longest
+#define METADATA_MAX_SIZE (8 + MAX_COLUMNS * (12 + NAME_MAX_SIZE + 1))
+
+static void write_all(int fd, const void* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t bytes_written = write(fd, data, length);
+        if (bytes_written == -1)
+        {
+            printf("Error Writing to File\n");
+            exit(EXIT_FAILURE);
+        }
+        data += bytes_written;
+        length -= bytes_written;
+    }
+}
+
+static void write_padding(int fd, size_t length)
+{
+    static const uint8_t zeroes[COLUMNAR_ALIGNMENT] = {0};
+    size_t padding = align_to(length, COLUMNAR_ALIGNMENT) - length;
+    write_all(fd, zeroes, padding);
+}
+
+// function to append a 32 or 64 bit field to a metadata buffer
+static uint32_t put_u32(uint8_t* metadata, uint32_t position, uint32_t value)
+{
+    memcpy(metadata + position, &value, sizeof(value));
+    return position + sizeof(value);
+}
+
+static uint32_t put_u64(uint8_t* metadata, uint32_t position, uint64_t value)
+{
+    memcpy(metadata + position, &value, sizeof(value));
+    return position + sizeof(value);
+}
+
+// function to write the framing and metadata of a message. The body,
+// if any, follows straight after.
+static void write_message_header(int fd, uint8_t* metadata, uint32_t metadata_length)
+{
+    uint32_t padded_length = align_to(metadata_length, COLUMNAR_ALIGNMENT);
+    memset(metadata + metadata_length, 0, padded_length - metadata_length);
+
+    uint32_t prefix[2] = {MESSAGE_CONTINUATION, padded_length};
+    write_all(fd, prefix, sizeof(prefix));
+    write_all(fd, metadata, padded_length);
+}
+
+static void write_schema(BatchWriter* writer)
+{
+    Schema* schema = writer->schema;
+    uint8_t metadata[METADATA_MAX_SIZE + COLUMNAR_ALIGNMENT];
+
+    uint32_t position = put_u32(metadata, 0, MESSAGE_SCHEMA);
+    position = put_u32(metadata, position, schema->column_count);
+
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        Column* column = &(schema->columns[i]);
+        uint32_t name_length = strlen(column->name);
+
+        if (column->type == COLUMN_INT)
+        {
+            position = put_u32(metadata, position, COLUMNAR_TYPE_INT);
+            position = put_u32(metadata, position, INT_COLUMN_SIZE * 8);
+        }
+        else
+        {
+            position = put_u32(metadata, position, COLUMNAR_TYPE_UTF8);
+            position = put_u32(metadata, position, column->size - 1);
+        }
+        position = put_u32(metadata, position, name_length);
+
+        memset(metadata + position, 0, align_to(name_length, sizeof(uint32_t)));
+        memcpy(metadata + position, column->name, name_length);
+        position += align_to(name_length, sizeof(uint32_t));
+    }
+
+    write_message_header(writer->fd, metadata, position);
+}
+
+// function to write out the rows gathered so far as a record batch
+static void batch_writer_flush(BatchWriter* writer)
+{
+    Schema* schema = writer->schema;
+    uint32_t row_count = writer->row_count;
+
+    if (row_count == 0)
+    {
+        return;
+    }
+
+    // list the buffers of every column, in order, and where they sit
+    // in the body
+    void* buffers[2 * MAX_COLUMNS];
+    uint64_t lengths[2 * MAX_COLUMNS];
+    uint32_t buffer_count = 0;
+
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        if (schema->columns[i].type == COLUMN_INT)
+        {
+            buffers[buffer_count] = writer->values[i];
+            lengths[buffer_count++] = row_count * INT_COLUMN_SIZE;
+        }
+        else
+        {
+            buffers[buffer_count] = writer->offsets[i];
+            lengths[buffer_count++] = (row_count + 1) * sizeof(uint32_t);
+            buffers[buffer_count] = writer->values[i];
+            lengths[buffer_count++] = writer->data_length[i];
+        }
+    }
+
+    uint8_t metadata[16 + 2 * MAX_COLUMNS * 16 + COLUMNAR_ALIGNMENT];
+    uint32_t position = put_u32(metadata, 0, MESSAGE_RECORD_BATCH);
+    position = put_u32(metadata, position, buffer_count);
+    position = put_u64(metadata, position, row_count);
+
+    uint64_t body_offset = 0;
+    for (uint32_t i = 0; i < buffer_count; i++)
+    {
+        position = put_u64(metadata, position, body_offset);
+        position = put_u64(metadata, position, lengths[i]);
+        body_offset += align_to(lengths[i], COLUMNAR_ALIGNMENT);
+    }
+
+    write_message_header(writer->fd, metadata, position);
+
+    for (uint32_t i = 0; i < buffer_count; i++)
+    {
+        write_all(writer->fd, buffers[i], lengths[i]);
+        write_padding(writer->fd, lengths[i]);
+    }
+
+    writer->row_count = 0;
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        writer->data_length[i] = 0;
+    }
+}
+
+// function to start a result stream, which begins with the schema
+void batch_writer_open(BatchWriter* writer, Schema* schema, int fd)
+{
+    writer->schema = schema;
+    writer->fd = fd;
+    writer->row_count = 0;
+
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        Column* column = &(schema->columns[i]);
+        writer->data_length[i] = 0;
+
+        if (column->type == COLUMN_INT)
+        {
+            writer->values[i] = malloc(BATCH_MAX_ROWS * INT_COLUMN_SIZE);
+            writer->offsets[i] = NULL;
+        }
+        else
+        {
+            // the null terminators aren't written out
+            writer->values[i] = malloc(BATCH_MAX_ROWS * (column->size - 1));
+            writer->offsets[i] = malloc((BATCH_MAX_ROWS + 1) * sizeof(uint32_t));
+            writer->offsets[i][0] = 0;
+        }
+    }
+
+    write_schema(writer);
+}
+
+// function to add rows that sit next to each other in memory, one
+// row size apart, as they do on a page. The batch is filled a column
+// at a time: integers are copied straight out of the rows with a
+// fixed stride, and text is copied without its padding.
+void batch_writer_append_rows(BatchWriter* writer, void* rows, uint32_t count)
+{
+    Schema* schema = writer->schema;
+
+    while (count > 0)
+    {
+        uint32_t batch_rows = BATCH_MAX_ROWS - writer->row_count;
+        if (batch_rows > count)
+        {
+            batch_rows = count;
+        }
+
+        for (uint32_t i = 0; i < schema->column_count; i++)
+        {
+            Column* column = &(schema->columns[i]);
+            void* source = rows + column->offset;
+
+            if (column->type == COLUMN_INT)
+            {
+                uint8_t* destination = writer->values[i] + writer->row_count * INT_COLUMN_SIZE;
+                for (uint32_t r = 0; r < batch_rows; r++)
+                {
+                    memcpy(destination + r * INT_COLUMN_SIZE, source + r * schema->row_size, INT_COLUMN_SIZE);
+                }
+            }
+            else
+            {
+                uint32_t* offsets = writer->offsets[i] + writer->row_count;
+                for (uint32_t r = 0; r < batch_rows; r++)
+                {
+                    char* text = source + r * schema->row_size;
+                    uint32_t length = strnlen(text, column->size - 1);
+                    memcpy(writer->values[i] + writer->data_length[i], text, length);
+                    writer->data_length[i] += length;
+                    offsets[r + 1] = writer->data_length[i];
+                }
+            }
+        }
+
+        writer->row_count += batch_rows;
+        rows += batch_rows * schema->row_size;
+        count -= batch_rows;
+
+        if (writer->row_count == BATCH_MAX_ROWS)
+        {
+            batch_writer_flush(writer);
+        }
+    }
+}
+
+// function to write out the last batch and end the stream
+void batch_writer_close(BatchWriter* writer)
+{
+    batch_writer_flush(writer);
+
+    uint32_t end_of_stream[2] = {MESSAGE_CONTINUATION, 0};
+    write_all(writer->fd, end_of_stream, sizeof(end_of_stream));
+
+    for (uint32_t i = 0; i < writer->schema->column_count; i++)
+    {
+        free(writer->values[i]);
+        free(writer->offsets[i]);
+    }
+}
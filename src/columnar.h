@@ -0,0 +1,32 @@
+/*
+ * COLUMNAR
+ * -----------
+ *  This file contains utilities to write select results in a binary,
+ *  columnar format modeled on the Arrow IPC stream format, so results
+ *  can be consumed without parsing text. While the stream goes to
+ *  stdout, the prompt and status text go to stderr instead.
+ *
+ *  A stream is a sequence of messages, each of them
+ *      0xFFFFFFFF, metadata length (uint32), metadata, body
+ *  with every field little endian and the metadata and body buffers
+ *  padded to 8 bytes. It starts with a schema message
+ *      type = 1, column count, then per column:
+ *          type (2 = int, 5 = utf8), bit width or max length,
+ *          name length, name (padded to 4 bytes)
+ *  followed by record batches of up to BATCH_MAX_ROWS rows
+ *      type = 2, buffer count, row count (uint64), then per buffer:
+ *          offset into the body (uint64), length (uint64)
+ *  where int columns have one buffer of values and utf8 columns an
+ *  offsets buffer (row count + 1 uint32s) and a data buffer. The
+ *  stream ends with 0xFFFFFFFF followed by a zero length.
+ */
+#ifndef columnar_h
+#define columnar_h
+
+#include "globals.h"
+
+void batch_writer_open(BatchWriter* writer, Schema* schema, int fd);
+void batch_writer_append_rows(BatchWriter* writer, void* rows, uint32_t count);
+void batch_writer_close(BatchWriter* writer);
+
+#endif
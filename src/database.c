@@ -1,80 +1,419 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
 
 #include "globals.h"
 #include "pager.h"
+#include "codec.h"
 
 
-// function to create a new table
-Table* db_open(const char* filename)
+// function to work out the layout of a schema. This runs once, when
+// the table is created, and the result is stored in the catalog.
+void db_compile_schema(Schema* schema)
+{
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        Column* column = &(schema->columns[i]);
+        column->offset = offset;
+        offset += column->size;
+    }
+    schema->row_size = offset;
+    schema->rows_per_page = PAGE_USABLE_SIZE / schema->row_size;
+    schema->codec = row_codec_select(schema);
+}
+
+// function to add a column to a schema that is being built
+void db_add_column(Schema* schema, const char* name, ColumnType type, uint32_t size)
+{
+    Column* column = &(schema->columns[schema->column_count]);
+    strncpy(column->name, name, NAME_MAX_SIZE);
+    column->type = type;
+    column->size = size;
+    schema->column_count += 1;
+}
+
+// function to look a table up in the catalog by name
+Table* db_find_table(Database* db, const char* name)
+{
+    Catalog* catalog = db->catalog;
+    for (uint32_t i = 0; i < catalog->table_count; i++)
+    {
+        if (strcmp(catalog->tables[i].schema.name, name) == 0)
+        {
+            return &(catalog->tables[i]);
+        }
+    }
+    return NULL;
+}
+
+// function to add a new, empty table to the catalog
+ExecuteResult db_create_table(Database* db, Schema* schema)
+{
+    Catalog* catalog = db->catalog;
+
+    if (db_find_table(db, schema->name) != NULL)
+    {
+        return EXECUTE_TABLE_EXISTS;
+    }
+    if (catalog->table_count >= MAX_TABLES)
+    {
+        return EXECUTE_CATALOG_FULL;
+    }
+
+    Table* table = &(catalog->tables[catalog->table_count]);
+    memset(table, 0, sizeof(Table));
+    table->schema = *schema;
+    db_compile_schema(&(table->schema));
+
+    catalog->table_count += 1;
+    return EXECUTE_SUCCESS;
+}
+
+
+// function to open the database file and load its catalog
+Database* db_open(const char* filename)
 {
     // printf("Opening the Database\n");
     Pager* pager = pager_open(filename);
-    uint32_t num_rows = pager->file_length / ROW_SIZE;
+    bool is_new = pager->file_length == 0;
 
-    Table* table = malloc(sizeof(Table));
+    if (!is_new)
+    {
+        // everything we need to know about the file is in the header,
+        // so opening never has to scan the rest of it. We check what
+        // kind of file this is before its checksum, so that foreign
+        // or older files are reported as such rather than as corrupt.
+        Catalog header;
+        size_t header_size = offsetof(Catalog, page_count);
+        ssize_t bytes_read = pread(pager->file_desc, &header, header_size, 0);
+
+        if (bytes_read != (ssize_t)header_size || header.magic != FILE_MAGIC)
+        {
+            printf("Not a Hyperion database.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (header.format_version != FORMAT_VERSION || header.page_size != PAGE_SIZE)
+        {
+            printf("Unsupported database format (version %d, page size %d).\n",
+                    header.format_version, header.page_size);
+            exit(EXIT_FAILURE);
+        }
+        // we only ever write whole pages
+        if (pager->file_length % PAGE_SIZE != 0)
+        {
+            printf("Database file is corrupt.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    Database* db = malloc(sizeof(Database));
 
     // initialize all values to zero or null
-    table->pager = pager;
-    table->row_count = num_rows;
+    db->pager = pager;
+    db->backup_pid = 0;
+    db->output_mode = OUTPUT_TEXT;
+    db->output_fd = STDOUT_FILENO;
+    db->owns_output_fd = false;
+    db->output_redirects_stdout = false;
+
+    // the catalog is used in place, straight from the page cache.
+    // Loading it verifies its checksum.
+    db->catalog = get_page(pager, CATALOG_PAGE);
+
+    if (is_new)
+    {
+        // a fresh database starts out with the default table
+        //  id          integer
+        //  username    varchar(32)
+        //  email       varchar(255)
+        Schema schema = {0};
+        strcpy(schema.name, DEFAULT_TABLE_NAME);
+        db_add_column(&schema, "id", COLUMN_INT, INT_COLUMN_SIZE);
+        db_add_column(&schema, "username", COLUMN_TEXT, COLUMN_USERNAME_SIZE + 1);
+        db_add_column(&schema, "email", COLUMN_TEXT, COLUMN_EMAIL_SIZE + 1);
+        db->catalog->magic = FILE_MAGIC;
+        db->catalog->format_version = FORMAT_VERSION;
+        db->catalog->page_size = PAGE_SIZE;
+        db_create_table(db, &schema);
+    }
+    else
+    {
+        // Data pages are checked against their checksums as they're
+        // first loaded.
+        Catalog* header = db->catalog;
+        if (header->page_count > pager->num_pages)
+        {
+            printf("Database file is truncated (%d of %d pages).\n",
+                    pager->num_pages, header->page_count);
+            exit(EXIT_FAILURE);
+        }
+
+        // codecs are functions of this binary, so they're chosen
+        // afresh rather than trusted from the file
+        for (uint32_t i = 0; i < header->table_count; i++)
+        {
+            Schema* schema = &(header->tables[i].schema);
+            schema->codec = row_codec_select(schema);
+        }
+    }
+
+    return db;
+}
 
-    return table;
+// function to check whether a file is the open database file, under
+// any name, link or file descriptor
+static bool db_is_same_file(Database* db, struct stat* file_stat)
+{
+    struct stat database_stat;
+
+    if (fstat(db->pager->file_desc, &database_stat) == -1)
+    {
+        return false;
+    }
+    return database_stat.st_dev == file_stat->st_dev && database_stat.st_ino == file_stat->st_ino;
 }
 
+// function to check whether a path names the open database file
+static bool db_is_database_file(Database* db, const char* filename)
+{
+    struct stat target_stat;
+    return stat(filename, &target_stat) == 0 && db_is_same_file(db, &target_stat);
+}
 
-void db_close(Table* table)
+// function to choose how select results are written. Columnar output
+// goes to stdout when there's no target, to the given file descriptor
+// when the target is a number, and to a file otherwise.
+// ----
+// While columnar output goes to stdout, the stream is written to a
+// duplicate of stdout and everything printed as text (the prompt,
+// status and errors) is moved to stderr, so stdout carries nothing
+// but the stream from the moment the mode is switched on.
+bool db_set_output(Database* db, OutputMode mode, const char* target)
 {
-    // function to flush the page cache to disk, free all memory
-    // and close the file
+    int fd = STDOUT_FILENO;
+    bool owns_fd = false;
 
-    Pager* pager = table->pager;
-    uint32_t num_full_pages = table->row_count / ROWS_PER_PAGE;
+    if (target != NULL && strspn(target, "0123456789") == strlen(target))
+    {
+        fd = atoi(target);
 
-    for (uint32_t i = 0; i < num_full_pages; i++)
+        // results must never be written into the database itself
+        struct stat target_stat;
+        if (fd == db->pager->file_desc || fstat(fd, &target_stat) == -1 || db_is_same_file(db, &target_stat))
+        {
+            return false;
+        }
+    }
+    else if (target != NULL)
     {
-        // prevent double-free 
-        if (pager->pages[i] == NULL)
+        // and opening it here would truncate it
+        if (db_is_database_file(db, target))
         {
-            continue;
+            return false;
         }
 
-        // flush the page to file
-        pager_flush(pager, i, PAGE_SIZE);
-        free(pager->pages[i]);
-        pager->pages[i] = NULL;
+        fd = open(target,
+                O_WRONLY |    // Write only
+                O_CREAT |     // Create file if it does not exist
+                O_TRUNC,      // Discard any previous contents
+                S_IWUSR |     // User write permission
+                S_IRUSR       // User read permission
+                );
+        if (fd == -1)
+        {
+            return false;
+        }
+        owns_fd = true;
     }
 
-    // ensure there isn't a partial page to write
-    uint32_t additional_rows = table->row_count % ROWS_PER_PAGE;
+    // text goes back to stdout before we let go of the previous output
+    fflush(stdout);
+    if (db->output_redirects_stdout)
+    {
+        dup2(db->output_fd, STDOUT_FILENO);
+        db->output_redirects_stdout = false;
+    }
+    if (db->owns_output_fd)
+    {
+        close(db->output_fd);
+    }
 
-    if (additional_rows > 0)
+    if (mode == OUTPUT_COLUMNAR && fd == STDOUT_FILENO)
     {
-        uint32_t page_num = num_full_pages;
-        if (pager->pages[page_num] != NULL)
+        fd = dup(STDOUT_FILENO);
+        if (fd == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1)
         {
-            pager_flush(pager, page_num, additional_rows * ROW_SIZE);
-            free(pager->pages[page_num]);
-            pager->pages[page_num] = NULL;
+            if (fd != -1)
+            {
+                close(fd);
+            }
+            db->output_mode = OUTPUT_TEXT;
+            db->output_fd = STDOUT_FILENO;
+            db->owns_output_fd = false;
+            return false;
         }
+        owns_fd = true;
+        db->output_redirects_stdout = true;
+    }
+
+    db->output_mode = mode;
+    db->output_fd = fd;
+    db->owns_output_fd = owns_fd;
+    return true;
+}
+
+// function to record the number of pages in the header, so it's
+// current whenever the header page is written out
+static void db_sync_header(Database* db)
+{
+    db->catalog->page_count = db->pager->num_pages;
+}
+
+
+// function to reap a finished backup process without blocking
+static void db_reap_backup(Database* db, int options)
+{
+    if (db->backup_pid == 0)
+    {
+        return;
+    }
+
+    int status;
+    pid_t result = waitpid(db->backup_pid, &status, options);
+
+    // still running
+    if (result == 0)
+    {
+        return;
+    }
+
+    if (result == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        printf("Error: Backup did not complete.\n");
+    }
+    db->backup_pid = 0;
+}
+
+
+// function to take a consistent snapshot of the database without
+// stopping the engine.
+// ----
+// We fork(), so the child process sees the page cache and row count
+// exactly as they are right now, shared copy-on-write with the parent.
+// The child streams the pages to the target file in page order while
+// the parent goes straight back to accepting queries; only the pages
+// the parent writes to from here on are actually duplicated.
+BackupOutcomes db_backup(Database* db, const char* filename)
+{
+    // only one backup runs at a time
+    db_reap_backup(db, WNOHANG);
+    if (db->backup_pid != 0)
+    {
+        return BACKUP_IN_PROGRESS;
+    }
+
+    // never write the backup over the database itself
+    if (db_is_database_file(db, filename))
+    {
+        return BACKUP_SAME_FILE;
+    }
+
+    // the snapshot goes to a temporary file next to the target, which
+    // is only renamed into place once it's complete, so a failed
+    // backup never leaves a half written file behind
+    char temporary_name[PATH_MAX];
+    int length = snprintf(temporary_name, sizeof(temporary_name), "%s.XXXXXX", filename);
+    if (length < 0 || length >= (int)sizeof(temporary_name))
+    {
+        return BACKUP_OPEN_FAILED;
+    }
+
+    int fd = mkstemp(temporary_name);
+    if (fd == -1)
+    {
+        return BACKUP_OPEN_FAILED;
     }
 
-    int result = close(pager->file_desc);
-    if (result == -1)
+    // make sure pending output isn't printed twice by the child, and
+    // update the header before forking so the child never writes to
+    // the shared cache
+    fflush(stdout);
+    db_sync_header(db);
+
+    pid_t pid = fork();
+
+    if (pid == -1)
     {
-        printf("Error closing the database file.\n");
-        exit(EXIT_FAILURE);
+        close(fd);
+        unlink(temporary_name);
+        return BACKUP_FORK_FAILED;
     }
 
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++)
+    if (pid == 0)
     {
-        void* page = pager->pages[i];
-        if (page)
+        // child: write out the frozen snapshot, with the same layout
+        // db_close() would produce
+        // The catalog page is part of the snapshot as well
+        Pager* pager = db->pager;
+
+        for (uint32_t i = 0; i < pager->num_pages; i++)
         {
-            free(page);
-            pager->pages[i] = NULL;
+            pager_copy_page(pager, i, fd);
         }
+
+        if (fsync(fd) == -1 || close(fd) == -1 || rename(temporary_name, filename) == -1)
+        {
+            unlink(temporary_name);
+            _exit(EXIT_FAILURE);
+        }
+        // _exit() so we skip stdio buffers and atexit handlers that
+        // belong to the parent
+        _exit(EXIT_SUCCESS);
     }
-    free(pager);
-    free(table);
+
+    // parent: the child owns the target file now
+    close(fd);
+    db->backup_pid = pid;
+    return BACKUP_STARTED;
 }
 
+
+void db_close(Database* db)
+{
+    // function to flush the page cache to disk, free all memory
+    // and close the file
+
+    // let a running backup finish before we tear the cache down
+    db_reap_backup(db, 0);
+
+    Pager* pager = db->pager;
+    db_sync_header(db);
+
+    for (uint32_t i = 0; i < pager->num_pages; i++)
+    {
+        // pages that were never loaded are already on disk
+        if (pager->pages[i] == NULL)
+        {
+            continue;
+        }
+
+        // flush the page to file
+        pager_flush(pager, i);
+        pager_release_page(pager, i);
+    }
+
+    pager_close(pager);
+
+    if (db->owns_output_fd)
+    {
+        close(db->output_fd);
+    }
+    free(db);
+}
@@ -3,17 +3,25 @@
  * ------------------------
  *  This file contains utilities for the following purposes
  *  1. Opening the Database from the file
- *  2. Loading said data into memory
+ *  2. Loading said data into memory, starting with the catalog of tables
  *  3. Running a query on the in-memory cache
  *  4. Flushing the Cache to Disk once the database is closed
+ *  5. Taking online backups of the Database
+ *  6. Choosing where query results are written
  */
 #ifndef database_h
 #define database_h
 
 #include "globals.h"
 
-Table* db_open(const char* filename);
-void db_close(Table* table);
+void db_compile_schema(Schema* schema);
+void db_add_column(Schema* schema, const char* name, ColumnType type, uint32_t size);
+Table* db_find_table(Database* db, const char* name);
+ExecuteResult db_create_table(Database* db, Schema* schema);
+Database* db_open(const char* filename);
+bool db_set_output(Database* db, OutputMode mode, const char* target);
+BackupOutcomes db_backup(Database* db, const char* filename);
+void db_close(Database* db);
 
 #endif
 
@@ -6,63 +6,250 @@
 #include "utils.h"
 #include "pager.h"
 #include "database.h"
+#include "sort.h"
+#include "columnar.h"
+#include "codec.h"
 
 
-MetaCommandOutcomes do_meta_command(InputBuffer* input_buffer, Table* table)
+MetaCommandOutcomes do_meta_command(InputBuffer* input_buffer, Database* db)
 {
-    // as of right now, we only support the exit meta command.
     if (strcmp(input_buffer->buffer, ".exit") == 0)
     {
-        db_close(table);
+        db_close(db);
         exit(EXIT_SUCCESS);
     }
+    else if (strncmp(input_buffer->buffer, ".backup", 7) == 0)
+    {
+        // .backup <path>
+        char* keyword = strtok(input_buffer->buffer, " ");
+        char* filename = strtok(NULL, " ");
+
+        if (filename == NULL)
+        {
+            return META_COMMAND_SYNTAX_ERROR;
+        }
+
+        switch (db_backup(db, filename))
+        {
+            case (BACKUP_STARTED):
+                return META_COMMAND_SUCCESS;
+            case (BACKUP_IN_PROGRESS):
+                printf("A backup is already in progress.\n");
+                break;
+            case (BACKUP_SAME_FILE):
+                printf("Cannot back up the database onto itself.\n");
+                break;
+            case (BACKUP_OPEN_FAILED):
+                printf("Unable to Open file %s\n", filename);
+                break;
+            case (BACKUP_FORK_FAILED):
+                printf("Unable to start the backup process.\n");
+                break;
+        }
+        return META_COMMAND_BACKUP_FAILED;
+    }
+    else if (strncmp(input_buffer->buffer, ".mode", 5) == 0)
+    {
+        // .mode text | .mode arrow [<path> | <file descriptor>]
+        char* keyword = strtok(input_buffer->buffer, " ");
+        char* mode = strtok(NULL, " ");
+        char* target = strtok(NULL, " ");
+
+        if (mode == NULL || strtok(NULL, " ") != NULL)
+        {
+            return META_COMMAND_SYNTAX_ERROR;
+        }
+
+        bool changed;
+        if (strcmp(mode, "text") == 0 && target == NULL)
+        {
+            changed = db_set_output(db, OUTPUT_TEXT, NULL);
+        }
+        else if (strcmp(mode, "arrow") == 0)
+        {
+            changed = db_set_output(db, OUTPUT_COLUMNAR, target);
+        }
+        else
+        {
+            return META_COMMAND_SYNTAX_ERROR;
+        }
+
+        return changed ? META_COMMAND_SUCCESS : META_COMMAND_OUTPUT_FAILED;
+    }
     else
     {
         return META_COMMAND_UNRECOGNIZED_COMMAND;
     }
 }
 
-ExecuteResult execute_insert(Statement* statement, Table* table)
+ExecuteResult execute_insert(Statement* statement, Database* db)
 {
-    // make sure the table isn't full
-    if (table->row_count >= TABLE_MAX_ROWS)
+    Table* table = statement->table;
+    Schema* schema = &(table->schema);
+
+    // the last page of the table is full (or there isn't one yet), so
+    // the table needs a fresh page
+    if (table->row_count % schema->rows_per_page == 0)
     {
-        return EXECUTE_TABLE_FULL;
+        // make sure neither the table nor the file is full
+        if (table->page_count >= TABLE_MAX_PAGES)
+        {
+            return EXECUTE_TABLE_FULL;
+        }
+
+        uint32_t page_num = pager_allocate_page(db->pager);
+        if (page_num == TABLE_MAX_PAGES)
+        {
+            return EXECUTE_TABLE_FULL;
+        }
+
+        table->pages[table->page_count] = page_num;
+        table->page_count += 1;
     }
-    else
+
+    // get the row we need to insert from the statement parser
+    Row* row_to_insert = &(statement->row_to_insert);
+    // serialize the row and write it to the end of the table
+    Cursor* cursor = table_end(db->pager, table);
+    serialize_row(schema, row_to_insert, cursor_value(cursor));
+    // increment the number of rows
+    table->row_count += 1;
+
+    free(cursor);
+    return EXECUTE_SUCCESS;
+}
+
+// function to write out rows that sit next to each other in memory,
+// either as text or, in bulk, into the current record batch
+static void emit_rows(Database* db, BatchWriter* writer, Schema* schema, void* rows, uint32_t count)
+{
+    if (db->output_mode == OUTPUT_COLUMNAR)
     {
-        // get the row we need to insert from the statement parser
-        Row* row_to_insert = &(statement->row_to_insert);
-        // serialize the row and write it to the location in the table
-        serialize_row(row_to_insert, row_slot(table, table->row_count));
-        // increment the number of rows
-        table->row_count += 1;
-        return EXECUTE_SUCCESS;
+        batch_writer_append_rows(writer, rows, count);
+        return;
+    }
+
+    const RowCodec* codec = row_codec(schema);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        codec->print(schema, rows + i * schema->row_size);
     }
 }
 
-ExecuteResult execute_select(Statement* statement, Table* table)
+// select with an ORDER BY: feed every row through the sorter, which
+// spills to disk when the table doesn't fit in its memory budget
+ExecuteResult execute_sorted_select(Statement* statement, Database* db)
 {
-    // create a new temporary location to hold the row
-    Row row;
-    for (uint32_t i = 0; i < table->row_count; i++)
+    Table* table = statement->table;
+    Schema* schema = &(table->schema);
+
+    // the sorter has to keep the skipped rows too
+    uint32_t sort_limit = statement->limit;
+    if (sort_limit != NO_LIMIT)
+    {
+        sort_limit = (sort_limit > NO_LIMIT - statement->offset) ? NO_LIMIT : sort_limit + statement->offset;
+    }
+
+    Sorter sorter;
+    sorter_init(&sorter, schema, statement->order_by_column,
+            statement->order_descending, sort_limit);
+
+    Cursor* cursor = table_start(db->pager, table);
+    while (!(cursor->end_of_table))
+    {
+        sorter_add(&sorter, cursor_value(cursor));
+        cursor_advance(cursor);
+    }
+    free(cursor);
+    sorter_finish(&sorter);
+
+    BatchWriter writer;
+    if (db->output_mode == OUTPUT_COLUMNAR)
     {
-        // copy from memory to temporary
-        deserialize_row(row_slot(table, i), &row);
-        print_row(&row);
+        batch_writer_open(&writer, schema, db->output_fd);
     }
+
+    void* row;
+    uint32_t skipped = 0;
+    while ((row = sorter_next(&sorter)) != NULL)
+    {
+        if (skipped < statement->offset)
+        {
+            skipped += 1;
+            continue;
+        }
+        emit_rows(db, &writer, schema, row, 1);
+    }
+
+    if (db->output_mode == OUTPUT_COLUMNAR)
+    {
+        batch_writer_close(&writer);
+    }
+
+    sorter_close(&sorter);
     return EXECUTE_SUCCESS;
 }
 
-ExecuteResult execute_statement(Statement* statement, Table* table)
+ExecuteResult execute_select(Statement* statement, Database* db)
+{
+    if (statement->has_order_by)
+    {
+        return execute_sorted_select(statement, db);
+    }
+
+    Table* table = statement->table;
+    Schema* schema = &(table->schema);
+
+    BatchWriter writer;
+    if (db->output_mode == OUTPUT_COLUMNAR)
+    {
+        batch_writer_open(&writer, schema, db->output_fd);
+    }
+
+    // OFFSET and LIMIT are pushed down into the scan: the cursor seeks
+    // straight past the skipped rows and we stop as soon as we have
+    // enough, so only the pages holding the result are ever loaded.
+    // Rows are handed out a page at a time, straight from the page.
+    Cursor* cursor = table_start(db->pager, table);
+    cursor_seek(cursor, statement->offset);
+
+    uint32_t remaining = statement->limit;
+    while (!(cursor->end_of_table) && remaining > 0)
+    {
+        uint32_t count = cursor_page_rows(cursor);
+        if (count > remaining)
+        {
+            count = remaining;
+        }
+
+        emit_rows(db, &writer, schema, cursor_value(cursor), count);
+        cursor_seek(cursor, cursor->row_num + count);
+        remaining -= count;
+    }
+    free(cursor);
+
+    if (db->output_mode == OUTPUT_COLUMNAR)
+    {
+        batch_writer_close(&writer);
+    }
+    return EXECUTE_SUCCESS;
+}
+
+ExecuteResult execute_create_table(Statement* statement, Database* db)
+{
+    return db_create_table(db, &(statement->schema));
+}
+
+ExecuteResult execute_statement(Statement* statement, Database* db)
 {
     // TODO fill in
     switch (statement->type)
     {
         case (STATEMENT_INSERT):
-            return execute_insert(statement, table);
+            return execute_insert(statement, db);
         case (STATEMENT_SELECT):
-            return execute_select(statement, table);
+            return execute_select(statement, db);
+        case (STATEMENT_CREATE_TABLE):
+            return execute_create_table(statement, db);
     }
 }
-
@@ -9,9 +9,11 @@
 
 #include "globals.h"
 
-MetaCommandOutcomes do_meta_command(InputBuffer* input_buffer, Table* table);
-ExecuteResult execute_insert(Statement* statement, Table* table);
-ExecuteResult execute_select(Statement* statement, Table* table);
-ExecuteResult execute_statement(Statement* statement, Table* table);
+MetaCommandOutcomes do_meta_command(InputBuffer* input_buffer, Database* db);
+ExecuteResult execute_insert(Statement* statement, Database* db);
+ExecuteResult execute_sorted_select(Statement* statement, Database* db);
+ExecuteResult execute_select(Statement* statement, Database* db);
+ExecuteResult execute_create_table(Statement* statement, Database* db);
+ExecuteResult execute_statement(Statement* statement, Database* db);
 
 #endif
@@ -10,6 +10,7 @@
  * 4. Small Utility Functions
  */
 #include <stdint.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <sys/types.h>
 
@@ -18,6 +19,45 @@
 #define COLUMN_EMAIL_SIZE 255
 #define TABLE_MAX_PAGES 100
 
+// catalog limits
+#define MAX_TABLES 4
+#define MAX_COLUMNS 8
+#define NAME_MAX_SIZE 31
+#define COLUMN_TEXT_MAX_SIZE 255
+#define DEFAULT_TABLE_NAME "users"
+
+// the header and catalog always live on the first page of the file
+#define CATALOG_PAGE 0
+
+// identifies a Hyperion database file ("HYPR"), and the version of
+// the on-disk format. Bump the version whenever the layout changes.
+#define FILE_MAGIC 0x48595052
+#define FORMAT_VERSION 2
+
+// 4Kb as most operating systems size pages at 4Kb
+// this means that pages won't be broken up by the operating system
+// as 4Kb is the virtual memory size of the system.
+// These are macros rather than extern constants so that the compiler
+// can fold them wherever they're used.
+#define PAGE_SIZE 4096
+
+// every page ends with a CRC32C of the rest of the page
+#define PAGE_CHECKSUM_SIZE sizeof(uint32_t)
+#define PAGE_USABLE_SIZE (PAGE_SIZE - PAGE_CHECKSUM_SIZE)
+#define INT_COLUMN_SIZE sizeof(uint32_t)
+#define ROW_MAX_SIZE (MAX_COLUMNS * (COLUMN_TEXT_MAX_SIZE + 1))
+
+// sorting: how many pages of rows a sort may hold in memory before it
+// spills a sorted run to disk, and how many runs are merged at once
+#define SORT_MEMORY_PAGES 16
+#define SORT_MERGE_FANIN 4
+
+// a select without a LIMIT
+#define NO_LIMIT UINT32_MAX
+
+// columnar output: the most rows in one record batch
+#define BATCH_MAX_ROWS 1024
+
 
 /*
  *  ---------------- ENUMS FOR ERROR HANDLING AND RETURN GUARANTEES ----
@@ -25,27 +65,60 @@
 
 typedef enum {
     META_COMMAND_SUCCESS,
-    META_COMMAND_UNRECOGNIZED_COMMAND
+    META_COMMAND_UNRECOGNIZED_COMMAND,
+    META_COMMAND_SYNTAX_ERROR,
+    META_COMMAND_BACKUP_FAILED,
+    META_COMMAND_OUTPUT_FAILED
 } MetaCommandOutcomes;
 
+typedef enum {
+    BACKUP_STARTED,
+    BACKUP_IN_PROGRESS,
+    BACKUP_SAME_FILE,
+    BACKUP_OPEN_FAILED,
+    BACKUP_FORK_FAILED
+} BackupOutcomes;
+
 typedef enum {
     PREPARE_SUCCESS,
     PREPARE_UNRECOGNIZED_STATEMENT,
     PREPARE_SYNTAX_ERROR,
     PREPARE_STRING_TOO_LONG,
-    PREPARE_NEGATIVE_ID
+    PREPARE_NEGATIVE_ID,
+    PREPARE_UNKNOWN_TABLE,
+    PREPARE_UNKNOWN_COLUMN,
+    PREPARE_TOO_MANY_COLUMNS
 } StatementPreparationOutcomes;
 
 typedef enum {
     STATEMENT_INSERT,
-    STATEMENT_SELECT
+    STATEMENT_SELECT,
+    STATEMENT_CREATE_TABLE
 } StatementType;
 
 typedef enum {
     EXECUTE_TABLE_FULL,
+    EXECUTE_TABLE_EXISTS,
+    EXECUTE_CATALOG_FULL,
     EXECUTE_SUCCESS
 } ExecuteResult;
 
+typedef enum {
+    COLUMN_INT,
+    COLUMN_TEXT
+} ColumnType;
+
+typedef enum {
+    OUTPUT_TEXT,
+    OUTPUT_COLUMNAR
+} OutputMode;
+
+// the row codecs, see codec.c
+typedef enum {
+    ROW_CODEC_GENERIC,
+    ROW_CODEC_USERS
+} RowCodecKind;
+
 /*
  *  ---------------- BASIC STRUCTURES AND TYPES -------------------------
  */
@@ -57,13 +130,42 @@ typedef struct {
     ssize_t input_length;
 } InputBuffer;
 
-// this is a row of our table
+// a row of a table, kept in exactly the layout it has on a page.
+// Serializing it is then a single memcpy of the
+// schema's row size rather than one copy per column.
 typedef struct {
-    uint32_t id;
-    char username[COLUMN_USERNAME_SIZE+1];
-    char email[COLUMN_EMAIL_SIZE+1];
+    uint8_t data[ROW_MAX_SIZE];
 } Row;
 
+// a column of a table. Integers are stored as 4 bytes and text
+// columns as a fixed-width, null-terminated buffer.
+typedef struct {
+    char name[NAME_MAX_SIZE+1];
+    uint32_t type;
+    uint32_t size;
+    uint32_t offset;
+} Column;
+
+// the schema of a table. Offsets, the row size and the rows per page
+// are worked out once when the table is created and stored alongside
+// the columns, so nothing is recomputed on the hot paths. So is the
+// codec, which is chosen again whenever the database is opened.
+typedef struct {
+    char name[NAME_MAX_SIZE+1];
+    uint32_t column_count;
+    Column columns[MAX_COLUMNS];
+    uint32_t row_size;
+    uint32_t rows_per_page;
+    uint32_t codec;
+} Schema;
+
+// how rows of a schema are encoded from the values of an insert, and
+// printed back out
+typedef struct {
+    StatementPreparationOutcomes (*encode)(Schema* schema, char** values, Row* row);
+    void (*print)(Schema* schema, void* row);
+} RowCodec;
+
 // create a Pager
 // the pager is an abstraction that allows us to access
 // blocks of memory more easily. This will be our primary interface
@@ -71,32 +173,136 @@ typedef struct {
 typedef struct {
     int file_desc;
     uint32_t file_length;
+    uint32_t num_pages;
     void* pages[TABLE_MAX_PAGES];
 } Pager;
 
+// a table, as stored in the catalog. Rows live on the pages listed in
+// `pages`, in order.
 typedef struct {
+    Schema schema;
     uint32_t row_count;
-    Pager* pager;
+    uint32_t page_count;
+    uint32_t pages[TABLE_MAX_PAGES];
 } Table;
 
+// the catalog is the first page of the file, after a header that
+// describes the file itself. It is used in place in the page cache,
+// so it's persisted whenever that page is flushed.
+typedef struct {
+    uint32_t magic;
+    uint32_t format_version;
+    uint32_t page_size;
+    // pages in the file, as of the last time it was written
+    uint32_t page_count;
+
+    uint32_t table_count;
+    Table tables[MAX_TABLES];
+} Catalog;
+
+_Static_assert(sizeof(Catalog) <= PAGE_USABLE_SIZE, "The catalog must fit in a page");
+
+// a position in a table. The page under the cursor is only loaded
+// when the row is read.
+typedef struct {
+    Pager* pager;
+    Table* table;
+    uint32_t row_num;
+    uint32_t page_index;
+    uint32_t slot;
+    void* page;
+    // the cursor is one past the last row
+    bool end_of_table;
+} Cursor;
+
+typedef struct {
+    Pager* pager;
+    Catalog* catalog;
+    // process id of the running background backup, 0 if there is none
+    pid_t backup_pid;
+    // how select results are written, and where to
+    OutputMode output_mode;
+    int output_fd;
+    // whether we opened output_fd ourselves, and must close it
+    bool owns_output_fd;
+    // whether stdout was handed to the columnar stream, with text
+    // moved to stderr in the meantime
+    bool output_redirects_stdout;
+} Database;
+
 typedef struct {
     StatementType type;
+    // the table the statement runs against
+    Table* table;
     Row row_to_insert;
+    // the schema of the table to create
+    Schema schema;
+    // ORDER BY, LIMIT and OFFSET of a select
+    bool has_order_by;
+    uint32_t order_by_column;
+    bool order_descending;
+    uint32_t limit;
+    uint32_t offset;
 } Statement;
 
-/*
- * ----------------- CONSTANT VALUES -----------------------------------
- */
+// a row in an in-memory sort: the leading bytes of its key, packed so
+// they compare as a plain integer, and where the row is
+typedef struct {
+    uint64_t prefix;
+    uint32_t index;
+} SortEntry;
+
+// a sorted run that was spilled to a scratch file. Rows are packed
+// into pages exactly like a table's pages.
+typedef struct {
+    Pager* pager;
+    uint32_t row_count;
+    // position of the next row while merging
+    uint32_t next_row;
+} SortRun;
+
+// a record batch being built for columnar output. Every column gets
+// its own contiguous buffer: integers as an array of values, text as
+// an array of offsets into a buffer of the bytes of every value.
+typedef struct {
+    Schema* schema;
+    int fd;
+    uint32_t row_count;
+    uint8_t* values[MAX_COLUMNS];
+    uint32_t* offsets[MAX_COLUMNS];
+    uint32_t data_length[MAX_COLUMNS];
+} BatchWriter;
+
+// the state of an ORDER BY. Rows are added one at a time and read back
+// in order once the sort is finished. Memory use is fixed: at most
+// SORT_MEMORY_PAGES pages of rows, plus a page per run while merging.
+typedef struct {
+    Schema* schema;
+    Column* column;
+    bool descending;
+    uint32_t limit;
+
+    // in-memory rows, and their sort keys
+    uint8_t* rows;
+    uint32_t row_capacity;
+    uint32_t row_count;
+    SortEntry* entries;
+    SortEntry* scratch_entries;
+
+    // with a small enough LIMIT we only keep the best rows, in a heap
+    bool is_top_k;
+
+    // spilled runs; runs before first_run have already been merged
+    SortRun* runs;
+    uint32_t run_count;
+    uint32_t first_run;
 
-extern const uint32_t ID_SIZE;
-extern const uint32_t USERNAME_SIZE;
-extern const uint32_t EMAIL_SIZE;
-extern const uint32_t ID_OFFSET;
-extern const uint32_t USERNAME_OFFSET;
-extern const uint32_t EMAIL_OFFSET;
-extern const uint32_t ROW_SIZE;
-extern const uint32_t PAGE_SIZE; 
-extern const uint32_t ROWS_PER_PAGE;
-extern const uint32_t TABLE_MAX_ROWS;
+    // read back state
+    uint32_t rows_returned;
+    uint32_t* merge_heap;
+    uint32_t merge_heap_size;
+    // the run whose row was returned last and must advance
+    int32_t pending_run;
+} Sorter;
 
 #endif
@@ -20,14 +20,17 @@
 /*
  * Hyperion - A Simple SQLite clone
  *
- * As of now, There exists only a single table
+ * Every database starts out with a default table, `users`
  * ---------------------------------------------
  *  id          integer
  *  username    varchar(32)
  *  email       varchar(255)
  *  -------------------------------------------
+ *  and more tables can be added with CREATE TABLE.
  *
- *  Hyperion supports Insertion and Read operations.
+ *  Hyperion supports Insertion and Read operations, as well as
+ *  online backups through the .backup meta-command, and binary
+ *  columnar results through the .mode meta-command.
  */
 
 
@@ -42,8 +45,8 @@ int main(int argc, char* argv[])
 
     char* filename = argv[1];
 
-    // initialize the table
-    Table* table = db_open(filename);
+    // open the database and its catalog of tables
+    Database* db = db_open(filename);
 
     // initialize the new input buffer to accept the commands
     // Since this persists, we use it throughout the lifetime of the application
@@ -58,13 +61,22 @@ int main(int argc, char* argv[])
         // handle meta-command case
         if (input_buffer->buffer[0] == '.')
         {
-            switch(do_meta_command(input_buffer, table))
+            switch(do_meta_command(input_buffer, db))
             {
                 case (META_COMMAND_SUCCESS):
                     continue;
                 case (META_COMMAND_UNRECOGNIZED_COMMAND):
                     printf("Unrecongized command %s\n", input_buffer->buffer);
                     continue;
+                case (META_COMMAND_SYNTAX_ERROR):
+                    printf("Syntax Error: Could not Parse Command\n");
+                    continue;
+                case (META_COMMAND_BACKUP_FAILED):
+                    printf("Error: Backup Failed!\n");
+                    continue;
+                case (META_COMMAND_OUTPUT_FAILED):
+                    printf("Error: Could not Open the Output!\n");
+                    continue;
             }
         }
 
@@ -72,7 +84,7 @@ int main(int argc, char* argv[])
         Statement exec_statement;
 
         // parse the statement into internal representation
-        switch (prepare_statement(input_buffer, &exec_statement))
+        switch (prepare_statement(input_buffer, &exec_statement, db))
         {
             case (PREPARE_SUCCESS):
                 break;
@@ -89,10 +101,20 @@ int main(int argc, char* argv[])
                 continue;
             case (PREPARE_NEGATIVE_ID):
                 printf("The ID cannot be negative.\n");
+                continue;
+            case (PREPARE_UNKNOWN_TABLE):
+                printf("No such table.\n");
+                continue;
+            case (PREPARE_UNKNOWN_COLUMN):
+                printf("No such column.\n");
+                continue;
+            case (PREPARE_TOO_MANY_COLUMNS):
+                printf("A table can have at most %d columns.\n", MAX_COLUMNS);
+                continue;
         }
 
         // finally, execute the statement
-        switch(execute_statement(&exec_statement, table))
+        switch(execute_statement(&exec_statement, db))
         {
             case (EXECUTE_SUCCESS):
                 printf("Executed\n");
@@ -100,6 +122,12 @@ int main(int argc, char* argv[])
             case (EXECUTE_TABLE_FULL):
                 printf("Error: The Table is Full!\n");
                 break;
+            case (EXECUTE_TABLE_EXISTS):
+                printf("Error: The Table already exists!\n");
+                break;
+            case (EXECUTE_CATALOG_FULL):
+                printf("Error: The Database can hold at most %d tables!\n", MAX_TABLES);
+                break;
         }
 
         // printf("Executed!\n");
@@ -1,11 +1,62 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 #include "globals.h"
 #include "pager.h"
+#include "checksum.h"
+
+// function to write the checksum of a page into its last bytes
+static void page_stamp_checksum(void* page)
+{
+    uint32_t checksum = crc32c(page, PAGE_USABLE_SIZE);
+    memcpy(page + PAGE_USABLE_SIZE, &checksum, PAGE_CHECKSUM_SIZE);
+}
+
+// function to check that a page read from disk is the page we wrote
+static bool page_checksum_valid(void* page)
+{
+    uint32_t checksum;
+    memcpy(&checksum, page + PAGE_USABLE_SIZE, PAGE_CHECKSUM_SIZE);
+    return checksum == crc32c(page, PAGE_USABLE_SIZE);
+}
+
+// function to make sure a page read from disk is the page we wrote,
+// exiting if it's been corrupted
+static void page_verify_checksum(void* page, uint32_t page_number)
+{
+    if (!page_checksum_valid(page))
+    {
+        printf("Page %d is corrupt (checksum mismatch).\n", page_number);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// function to wrap an open file in a pager
+static Pager* pager_from_file(int fd)
+{
+    // find the size of the file
+    off_t file_length = lseek(fd, 0, SEEK_END);
+
+    Pager* pager = malloc(sizeof(Pager));
+
+    pager->file_desc = fd;
+    pager->file_length = file_length;
+    // we only ever write whole pages, so this is exact
+    pager->num_pages = file_length / PAGE_SIZE;
+
+    // initialize all pages to null
+    // do this so we prevent segfaults
+    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++)
+    {
+        pager->pages[i] = NULL;
+    }
+
+    return pager;
+}
 
 Pager* pager_open(const char* filename)
 {
@@ -27,22 +78,60 @@ Pager* pager_open(const char* filename)
         exit(EXIT_FAILURE);
     }
 
-    // find the size of the file
-    off_t file_length = lseek(fd, 0, SEEK_END);
+    return pager_from_file(fd);
+}
 
-    Pager* pager = malloc(sizeof(Pager));
+// function to create a pager over an anonymous scratch file, used to
+// spill data that doesn't fit in memory. The file is unlinked straight
+// away, so it disappears as soon as the pager is closed.
+Pager* pager_open_temporary()
+{
+    const char* directory = getenv("TMPDIR");
+    if (directory == NULL)
+    {
+        directory = "/tmp";
+    }
 
-    pager->file_desc = fd;
-    pager->file_length = file_length;
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/hyperion-XXXXXX", directory);
 
-    // initialize all pages to null
-    // do this so we prevent segfaults
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++)
+    int fd = mkstemp(filename);
+    if (fd == -1)
     {
-        pager->pages[i] = NULL;
+        printf("Unable to Open temporary file\n");
+        exit(EXIT_FAILURE);
     }
+    unlink(filename);
 
-    return pager;
+    return pager_from_file(fd);
+}
+
+// function to drop a page from the cache without writing it. Anything
+// that has to survive must be flushed first.
+void pager_release_page(Pager* pager, uint32_t page_num)
+{
+    free(pager->pages[page_num]);
+    pager->pages[page_num] = NULL;
+}
+
+// function to close the file and free the cache, without flushing
+void pager_close(Pager* pager)
+{
+    int result = close(pager->file_desc);
+    if (result == -1)
+    {
+        printf("Error closing the database file.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < TABLE_MAX_PAGES; i++)
+    {
+        if (pager->pages[i] != NULL)
+        {
+            pager_release_page(pager, i);
+        }
+    }
+    free(pager);
 }
 
 void* get_page(Pager* pager, uint32_t page_number)
@@ -51,7 +140,7 @@ void* get_page(Pager* pager, uint32_t page_number)
     // handle CACHE MISSES
 
     // ensure we don't breach pre-set limits for page numbers
-    if (page_number > TABLE_MAX_PAGES)
+    if (page_number >= TABLE_MAX_PAGES)
     {
         printf("Page Number Out of Bounds (%d > %d)\n", page_number, TABLE_MAX_PAGES);
         exit(EXIT_FAILURE);
@@ -66,30 +155,22 @@ void* get_page(Pager* pager, uint32_t page_number)
     if (pager->pages[page_number] == NULL)
     {
         // enter badlands
-        // allocate new memory for the fresh page
-        void* page = malloc(PAGE_SIZE);
+        // allocate new memory for the fresh page, zeroed so that unused
+        // slack never carries garbage to disk
+        void* page = calloc(1, PAGE_SIZE);
 
         // find the number of pages already present
         // ----
         // pager->file_length is initialized as soon as the database is
         // opened, and it tells us the length of the file at start in 
-        // bytes.
+        // bytes. Pages are always written whole.
         uint32_t num_pages = pager->file_length / PAGE_SIZE;
 
-        // if there's already more data (i.e. a partial page), we 
-        // will save it, too
-        if (pager->file_length % PAGE_SIZE)
-        {
-            num_pages += 1;
-        }
-
-        // this is to ensure we don't over-allocate for a partial write
-        // if we've got a page that we want that isn't the a fresh page,
-        // or if we want to load a page that's there previously 
+        // if we want to load a page that's there previously 
         // (i.e. assume you have 10 pages, and want to read page 6)
         // we use this function to also load pages from the file into
         // memory
-        if (page_number <= num_pages)
+        if (page_number < num_pages)
         {
             // change the file descriptor to start reading from the latest
             // page
@@ -105,15 +186,25 @@ void* get_page(Pager* pager, uint32_t page_number)
                 printf("Error reading File: %d\n", 0);
                 exit(EXIT_FAILURE);
             }
+
+            // pages are checked lazily, the first time they're loaded,
+            // so opening a database never has to read all of it
+            page_verify_checksum(page, page_number);
         }
         pager->pages[page_number] = page;
+
+        // keep track of the pages in use, including fresh ones
+        if (page_number >= pager->num_pages)
+        {
+            pager->num_pages = page_number + 1;
+        }
     }
     return pager->pages[page_number];
 }
 
 
 // this function writes a page number to the file
-void pager_flush(Pager* pager, uint32_t page_num,  uint32_t size)
+void pager_flush(Pager* pager, uint32_t page_num)
 {
 
     // sanity check
@@ -132,53 +223,187 @@ void pager_flush(Pager* pager, uint32_t page_num,  uint32_t size)
         exit(EXIT_FAILURE);
     }
 
-    ssize_t bytes_written = write(pager->file_desc, pager->pages[page_num], size);
+    page_stamp_checksum(pager->pages[page_num]);
+    ssize_t bytes_written = write(pager->file_desc, pager->pages[page_num], PAGE_SIZE);
 
     if (bytes_written == -1)
     {
         printf("Error Writing to File\n");
         exit(EXIT_FAILURE);
     }
+
+    // the page can now be loaded back from the file
+    if (offset + PAGE_SIZE > pager->file_length)
+    {
+        pager->file_length = offset + PAGE_SIZE;
+    }
 }
 
-void* row_slot(Table* table, uint32_t row_number)
+// this function copies a page into another file at the same offset.
+// Cached pages are written from memory, while pages that were never
+// loaded are copied straight from the database file (once their
+// checksum has been checked). pread/pwrite are
+// used so the shared file offset of the pager is never moved, which
+// keeps this safe to call from a forked backup process.
+// ----
+// It is only called from that process, so errors end it with _exit()
+// rather than running the parent's stdio and atexit cleanup.
+void pager_copy_page(Pager* pager, uint32_t page_num, int dest_fd)
 {
-    // get a slot in the table 
+    void* page = pager->pages[page_num];
+    char buffer[PAGE_SIZE];
+
+    if (page == NULL)
+    {
+        ssize_t bytes_read = pread(pager->file_desc, buffer, PAGE_SIZE, page_num * PAGE_SIZE);
+        if (bytes_read != PAGE_SIZE)
+        {
+            printf("Error reading File: page %d\n", page_num);
+            fflush(stdout);
+            _exit(EXIT_FAILURE);
+        }
+        // don't let a corrupt page into the backup
+        if (!page_checksum_valid(buffer))
+        {
+            printf("Page %d is corrupt (checksum mismatch).\n", page_num);
+            fflush(stdout);
+            _exit(EXIT_FAILURE);
+        }
+        page = buffer;
+    }
+    else
+    {
+        // stamp the checksum on a copy: writing to the cached page
+        // would make the kernel duplicate it for this process
+        memcpy(buffer, page, PAGE_USABLE_SIZE);
+        page_stamp_checksum(buffer);
+        page = buffer;
+    }
 
-    // rows are stored sequentially in pages, so we find the page
-    // index based on the count of the row
-    uint32_t page_number = row_number / ROWS_PER_PAGE;
+    ssize_t bytes_written = pwrite(dest_fd, page, PAGE_SIZE, page_num * PAGE_SIZE);
 
-    void* page = get_page(table->pager, page_number);
+    if (bytes_written != PAGE_SIZE)
+    {
+        printf("Error Writing to File\n");
+        fflush(stdout);
+        _exit(EXIT_FAILURE);
+    }
+}
 
-    // find the "index" of the row in the page
-    uint32_t row_offset = row_number % ROWS_PER_PAGE;
-    // find the byte offset for the row
-    uint32_t byte_offset = row_offset * ROW_SIZE;
+// this function hands out the next free page of the file, or
+// returns TABLE_MAX_PAGES if the file is full
+uint32_t pager_allocate_page(Pager* pager)
+{
+    if (pager->num_pages >= TABLE_MAX_PAGES)
+    {
+        return TABLE_MAX_PAGES;
+    }
+
+    uint32_t page_num = pager->num_pages;
+    // loading it marks it as in use
+    get_page(pager, page_num);
+    return page_num;
+}
+
+/*
+ * ---------------- CURSORS -------------------------------------------
+ * A cursor is a position in a table. Everything that reads or writes
+ * rows goes through one, so none of it needs to know how rows are laid
+ * out across pages.
+ */
+
+// function to get a cursor on the first row of a table
+Cursor* table_start(Pager* pager, Table* table)
+{
+    Cursor* cursor = malloc(sizeof(Cursor));
+    cursor->pager = pager;
+    cursor->table = table;
+    cursor_seek(cursor, 0);
+    return cursor;
+}
+
+// function to get a cursor just past the last row of a table, which
+// is where new rows go
+Cursor* table_end(Pager* pager, Table* table)
+{
+    Cursor* cursor = malloc(sizeof(Cursor));
+    cursor->pager = pager;
+    cursor->table = table;
+    cursor_seek(cursor, table->row_count);
+    return cursor;
+}
+
+// function to move a cursor straight to a row. Nothing is loaded until
+// the row is actually read, so seeking past rows never touches their
+// pages.
+void cursor_seek(Cursor* cursor, uint32_t row_num)
+{
+    uint32_t rows_per_page = cursor->table->schema.rows_per_page;
+
+    cursor->row_num = row_num;
+    // rows are stored sequentially in the table's pages, so we find
+    // the page index based on the count of the row
+    cursor->page_index = row_num / rows_per_page;
+    cursor->slot = row_num % rows_per_page;
+    cursor->page = NULL;
+    cursor->end_of_table = row_num >= cursor->table->row_count;
+}
+
+// function to move a cursor to the next row. Within a page this is
+// just a step of the row size; only crossing into the next page does
+// any more work.
+void cursor_advance(Cursor* cursor)
+{
+    cursor->row_num += 1;
+    cursor->slot += 1;
+
+    if (cursor->slot == cursor->table->schema.rows_per_page)
+    {
+        cursor->page_index += 1;
+        cursor->slot = 0;
+        cursor->page = NULL;
+    }
 
-    // return the exact memory location of the new row
-    return page + byte_offset;
+    if (cursor->row_num >= cursor->table->row_count)
+    {
+        cursor->end_of_table = true;
+    }
 }
 
-// serialization and deserialization for the rows
-void serialize_row(Row* source, void* destination)
+// function to count the rows from the cursor to the end of its page
+// (or of the table). They sit next to each other in memory, so they
+// can be handled in bulk.
+uint32_t cursor_page_rows(Cursor* cursor)
 {
-    // copy Y size data located at the second pointer to the first
-    // pointer at a specific offset
-    // printf("Before Copying (%d %s %s)\n", source->id, source->username, source->email);
-    memcpy(destination + ID_OFFSET, &(source->id), ID_SIZE);
-    memcpy(destination + USERNAME_OFFSET, &(source->username), USERNAME_SIZE);
-    memcpy(destination + EMAIL_OFFSET, &(source->email), EMAIL_SIZE);
-    // at this point of time, all our struct data has been placed at the location
-    // we want it to be at, which will be a page.
+    if (cursor->end_of_table)
+    {
+        return 0;
+    }
+
+    uint32_t page_rows = cursor->table->schema.rows_per_page - cursor->slot;
+    uint32_t table_rows = cursor->table->row_count - cursor->row_num;
+    return page_rows < table_rows ? page_rows : table_rows;
 }
 
-void deserialize_row(void* source, Row* destination)
+// function to get the memory location of the row under the cursor
+void* cursor_value(Cursor* cursor)
 {
-    // same thing as serializer, just reverse - we move data from the 
-    // page to the struct.
-    memcpy(&(destination->id), source + ID_OFFSET, ID_SIZE);
-    memcpy(&(destination->username), source + USERNAME_OFFSET, USERNAME_SIZE);
-    memcpy(&(destination->email), source + EMAIL_OFFSET, EMAIL_SIZE);
-    // printf("Deserialized Row: (%d %s %s)\n", destination->id, destination->username, destination->email);
+    if (cursor->page == NULL)
+    {
+        cursor->page = get_page(cursor->pager, cursor->table->pages[cursor->page_index]);
+    }
+
+    // find the byte offset for the row
+    return cursor->page + cursor->slot * cursor->table->schema.row_size;
 }
+
+// serialization for the rows
+// ----
+// Rows are kept in their on-page layout (see the Row struct), which
+// the table's codec fills in from the values of an insert. That
+// fuses the per-column copies into one copy of the whole row.
+void serialize_row(Schema* schema, Row* source, void* destination)
+{
+    memcpy(destination, source->data, schema->row_size);
+}
+
@@ -3,11 +3,16 @@
  * -----------
  *  This file contains utilities to handle memory I/O and other
  *  related abstractions, including but not limited to
- *  1. Serializing and De-serializing rows
+ *  1. Serializing rows onto their pages
  *  2. The Pager Abstraction to handle easy access to rows
+ *     and the Cursor Abstraction to walk the rows of a table
  *  3. Function to get pages
  *  4. Write the cache to disk
  *  5. Get the latest row number / page to write to
+ *  6. Copy pages into another file (for backups)
+ *  7. Allocate fresh pages to tables
+ *  8. Scratch files for data that spills out of memory
+ *  9. Checksumming pages as they're written and first loaded
  */
 #ifndef pager_h
 #define pager_h
@@ -15,10 +20,19 @@
 #include "globals.h"
 
 Pager* pager_open(const char* filename);
+Pager* pager_open_temporary();
+void pager_release_page(Pager* pager, uint32_t page_num);
+void pager_close(Pager* pager);
 void* get_page(Pager* pager, uint32_t page_number);
-void pager_flush(Pager* pager, uint32_t page_num,  uint32_t size);
-void* row_slot(Table* table, uint32_t row_number);
-void serialize_row(Row* source, void* destination);
-void deserialize_row(void* source, Row* destination);
+void pager_flush(Pager* pager, uint32_t page_num);
+void pager_copy_page(Pager* pager, uint32_t page_num, int dest_fd);
+uint32_t pager_allocate_page(Pager* pager);
+Cursor* table_start(Pager* pager, Table* table);
+Cursor* table_end(Pager* pager, Table* table);
+void cursor_seek(Cursor* cursor, uint32_t row_num);
+void cursor_advance(Cursor* cursor);
+uint32_t cursor_page_rows(Cursor* cursor);
+void* cursor_value(Cursor* cursor);
+void serialize_row(Schema* schema, Row* source, void* destination);
 
 #endif
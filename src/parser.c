@@ -1,62 +1,302 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include "globals.h"
 #include "parser.h"
+#include "database.h"
+#include "codec.h"
 
-// dedicated function to prepare the insert statement using 
+// function to find the table a statement names, falling back to the
+// default table when it doesn't name one
+StatementPreparationOutcomes resolve_table(Database* db, const char* name, Statement* statement)
+{
+    if (name == NULL)
+    {
+        name = DEFAULT_TABLE_NAME;
+    }
+
+    statement->table = db_find_table(db, name);
+    if (statement->table == NULL)
+    {
+        return PREPARE_UNKNOWN_TABLE;
+    }
+    return PREPARE_SUCCESS;
+}
+
+// dedicated function to prepare the insert statement using
 // strtok() to prevent buffer overflows from scanf()
-StatementPreparationOutcomes prepare_insert(InputBuffer* input_buffer, Statement* statement)
+// ----
+// insert [into <table>] <value> <value> ...
+StatementPreparationOutcomes prepare_insert(InputBuffer* input_buffer, Statement* statement, Database* db)
 {
 
     statement->type = STATEMENT_INSERT;
     // local variables to hold tokenized data
     char* keyword = strtok(input_buffer->buffer, " ");
-    char* id_string = strtok(NULL, " ");
-    char* username = strtok(NULL, " ");
-    char* email = strtok(NULL, " ");
+    char* token = strtok(NULL, " ");
+    char* table_name = NULL;
+
+    if (token != NULL && strcmp(token, "into") == 0)
+    {
+        table_name = strtok(NULL, " ");
+        if (table_name == NULL)
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        token = strtok(NULL, " ");
+    }
+
+    StatementPreparationOutcomes outcome = resolve_table(db, table_name, statement);
+    if (outcome != PREPARE_SUCCESS)
+    {
+        return outcome;
+    }
+
+    // gather exactly one value per column, then let the table's codec
+    // lay them out in the row
+    Schema* schema = &(statement->table->schema);
+    char* values[MAX_COLUMNS];
+
+    for (uint32_t i = 0; i < schema->column_count; i++)
+    {
+        if (token == NULL)
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        values[i] = token;
+        token = strtok(NULL, " ");
+    }
+
+    // too many values
+    if (token != NULL)
+    {
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    return row_codec(schema)->encode(schema, values, &(statement->row_to_insert));
+}
+
+// function to read a row count, such as a LIMIT or an OFFSET.
+// Anything but plain digits that fit in 32 bits is refused, rather
+// than read as zero or wrapped around the way atoi() would.
+static bool parse_count(const char* string, uint32_t* count)
+{
+    // strtoul() would quietly accept leading spaces and a sign
+    if (string == NULL || !isdigit((unsigned char)string[0]))
+    {
+        return false;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long value = strtoul(string, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *count = value;
+    return true;
+}
+
+// select [* from <table>] [order by <column> [asc|desc]] [limit <count>] [offset <count>]
+StatementPreparationOutcomes prepare_select(InputBuffer* input_buffer, Statement* statement, Database* db)
+{
+    statement->type = STATEMENT_SELECT;
+    statement->has_order_by = false;
+    statement->order_descending = false;
+    statement->limit = NO_LIMIT;
+    statement->offset = 0;
+
+    char* keyword = strtok(input_buffer->buffer, " ");
+    char* token = strtok(NULL, " ");
+    char* table_name = NULL;
+    char* order_by_column = NULL;
 
-    if (id_string == NULL || username == NULL || email == NULL)
+    if (token != NULL && strcmp(token, "*") == 0)
+    {
+        token = strtok(NULL, " ");
+    }
+
+    if (token != NULL && strcmp(token, "from") == 0)
+    {
+        table_name = strtok(NULL, " ");
+        if (table_name == NULL)
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        token = strtok(NULL, " ");
+    }
+
+    if (token != NULL && strcmp(token, "order") == 0)
+    {
+        char* by_keyword = strtok(NULL, " ");
+        order_by_column = strtok(NULL, " ");
+        if (by_keyword == NULL || strcmp(by_keyword, "by") != 0 || order_by_column == NULL)
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        statement->has_order_by = true;
+
+        token = strtok(NULL, " ");
+        if (token != NULL && (strcmp(token, "asc") == 0 || strcmp(token, "desc") == 0))
+        {
+            statement->order_descending = strcmp(token, "desc") == 0;
+            token = strtok(NULL, " ");
+        }
+    }
+
+    if (token != NULL && strcmp(token, "limit") == 0)
+    {
+        if (!parse_count(strtok(NULL, " "), &(statement->limit)))
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        token = strtok(NULL, " ");
+    }
+
+    if (token != NULL && strcmp(token, "offset") == 0)
+    {
+        if (!parse_count(strtok(NULL, " "), &(statement->offset)))
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        token = strtok(NULL, " ");
+    }
+
+    if (token != NULL)
     {
         return PREPARE_SYNTAX_ERROR;
     }
 
-    int id = atoi(id_string);
-    if (id < 0)
+    StatementPreparationOutcomes outcome = resolve_table(db, table_name, statement);
+    if (outcome != PREPARE_SUCCESS || !statement->has_order_by)
+    {
+        return outcome;
+    }
+
+    // find the column to order by
+    Schema* schema = &(statement->table->schema);
+    for (uint32_t i = 0; i < schema->column_count; i++)
     {
-        return PREPARE_NEGATIVE_ID;
+        if (strcmp(schema->columns[i].name, order_by_column) == 0)
+        {
+            statement->order_by_column = i;
+            return PREPARE_SUCCESS;
+        }
     }
+    return PREPARE_UNKNOWN_COLUMN;
+}
+
+// create table <name> (<column> <type>, ...)
+// where <type> is either int or varchar(<size>)
+StatementPreparationOutcomes prepare_create_table(InputBuffer* input_buffer, Statement* statement)
+{
+    statement->type = STATEMENT_CREATE_TABLE;
 
+    // parentheses and commas are only separators here
+    const char* delimiters = " ,()";
+    char* keyword = strtok(input_buffer->buffer, delimiters);
+    char* table_keyword = strtok(NULL, delimiters);
+    char* table_name = strtok(NULL, delimiters);
 
-    if (strlen(username) > COLUMN_USERNAME_SIZE || strlen(email) > COLUMN_EMAIL_SIZE)
+    if (table_keyword == NULL || strcmp(table_keyword, "table") != 0 || table_name == NULL)
+    {
+        return PREPARE_SYNTAX_ERROR;
+    }
+    if (strlen(table_name) > NAME_MAX_SIZE)
     {
         return PREPARE_STRING_TOO_LONG;
     }
 
-    statement->row_to_insert.id = id;
-    strcpy(statement->row_to_insert.username, username);
-    strcpy(statement->row_to_insert.email, email);
+    Schema* schema = &(statement->schema);
+    memset(schema, 0, sizeof(Schema));
+    strcpy(schema->name, table_name);
+
+    char* column_name;
+    while ((column_name = strtok(NULL, delimiters)) != NULL)
+    {
+        char* type = strtok(NULL, delimiters);
+
+        if (type == NULL)
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+        if (schema->column_count >= MAX_COLUMNS)
+        {
+            return PREPARE_TOO_MANY_COLUMNS;
+        }
+        if (strlen(column_name) > NAME_MAX_SIZE)
+        {
+            return PREPARE_STRING_TOO_LONG;
+        }
+        for (uint32_t i = 0; i < schema->column_count; i++)
+        {
+            if (strcmp(schema->columns[i].name, column_name) == 0)
+            {
+                return PREPARE_SYNTAX_ERROR;
+            }
+        }
+
+        if (strcmp(type, "int") == 0 || strcmp(type, "integer") == 0)
+        {
+            db_add_column(schema, column_name, COLUMN_INT, INT_COLUMN_SIZE);
+        }
+        else if (strcmp(type, "varchar") == 0 || strcmp(type, "text") == 0)
+        {
+            char* size_string = strtok(NULL, delimiters);
+            if (size_string == NULL)
+            {
+                return PREPARE_SYNTAX_ERROR;
+            }
+
+            int size = atoi(size_string);
+            if (size <= 0)
+            {
+                return PREPARE_SYNTAX_ERROR;
+            }
+            if (size > COLUMN_TEXT_MAX_SIZE)
+            {
+                return PREPARE_STRING_TOO_LONG;
+            }
+            // leave room for the null terminator
+            db_add_column(schema, column_name, COLUMN_TEXT, size + 1);
+        }
+        else
+        {
+            return PREPARE_SYNTAX_ERROR;
+        }
+    }
+
+    if (schema->column_count == 0)
+    {
+        return PREPARE_SYNTAX_ERROR;
+    }
 
     return PREPARE_SUCCESS;
 }
 
-StatementPreparationOutcomes prepare_statement(InputBuffer* input_buffer, Statement* statement)
+StatementPreparationOutcomes prepare_statement(InputBuffer* input_buffer, Statement* statement, Database* db)
 {
     // this is the simplest SQL compiler to exist
     // function to prepare a statement based on the command
     // parse the SQL here?
     if (strncmp(input_buffer->buffer, "insert", 6) == 0)
     {
-        return prepare_insert(input_buffer, statement);
+        return prepare_insert(input_buffer, statement, db);
     }
     if (strncmp(input_buffer->buffer, "select", 6) == 0)
     {
-        statement->type = STATEMENT_SELECT;
-        return PREPARE_SUCCESS;
+        return prepare_select(input_buffer, statement, db);
+    }
+    if (strncmp(input_buffer->buffer, "create", 6) == 0)
+    {
+        return prepare_create_table(input_buffer, statement);
     }
 
     // if we've reached here, we don't know what command this is
     return PREPARE_UNRECOGNIZED_STATEMENT;
 }
-
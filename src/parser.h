@@ -5,14 +5,18 @@
  *  1. Accepting the query from the user
  *  2. Parsing the Query to decide if it's a meta-command or an SQL query
  *  3. Tokenizing the SQL query into internal representation
- *  4. Preparing the internal representation to be passed to the executor
+ *  4. Resolving the tables a query names against the catalog
+ *  5. Preparing the internal representation to be passed to the executor
  */
 #ifndef parser_h
 #define parser_h
 
 #include "globals.h"
 
-StatementPreparationOutcomes prepare_insert(InputBuffer* input_buffer, Statement* statement);
-StatementPreparationOutcomes prepare_statement(InputBuffer* input_buffer, Statement* statement);
+StatementPreparationOutcomes resolve_table(Database* db, const char* name, Statement* statement);
+StatementPreparationOutcomes prepare_insert(InputBuffer* input_buffer, Statement* statement, Database* db);
+StatementPreparationOutcomes prepare_select(InputBuffer* input_buffer, Statement* statement, Database* db);
+StatementPreparationOutcomes prepare_create_table(InputBuffer* input_buffer, Statement* statement);
+StatementPreparationOutcomes prepare_statement(InputBuffer* input_buffer, Statement* statement, Database* db);
 
 #endif
@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "pager.h"
+#include "sort.h"
+
+// the sort that qsort() comparisons refer to. The engine is single
+// threaded, so one is enough.
+static Sorter* sort_context = NULL;
+
+// function to compare the sort keys of two rows, honoring DESC
+static int compare_rows(Sorter* sorter, void* a, void* b)
+{
+    Column* column = sorter->column;
+    int result;
+
+    if (column->type == COLUMN_INT)
+    {
+        uint32_t value_a, value_b;
+        memcpy(&value_a, a + column->offset, INT_COLUMN_SIZE);
+        memcpy(&value_b, b + column->offset, INT_COLUMN_SIZE);
+        result = (value_a > value_b) - (value_a < value_b);
+    }
+    else
+    {
+        result = strcmp((char*)(a + column->offset), (char*)(b + column->offset));
+    }
+
+    return sorter->descending ? -result : result;
+}
+
+// function to pack the leading bytes of a row's key into an integer
+// that orders the same way the key does. Integers fit entirely; text
+// keeps its first 8 bytes, and rows that tie on those are compared in
+// full afterwards.
+static uint64_t key_prefix(Sorter* sorter, void* row)
+{
+    Column* column = sorter->column;
+    uint64_t prefix = 0;
+
+    if (column->type == COLUMN_INT)
+    {
+        uint32_t value;
+        memcpy(&value, row + column->offset, INT_COLUMN_SIZE);
+        prefix = (uint64_t)value << 32;
+    }
+    else
+    {
+        uint8_t* text = row + column->offset;
+        bool ended = false;
+        for (uint32_t i = 0; i < sizeof(uint64_t); i++)
+        {
+            uint8_t byte = 0;
+            if (!ended && i < column->size)
+            {
+                byte = text[i];
+                ended = byte == 0;
+            }
+            prefix = (prefix << 8) | byte;
+        }
+    }
+
+    return sorter->descending ? ~prefix : prefix;
+}
+
+static void* sorter_row(Sorter* sorter, uint32_t index)
+{
+    return sorter->rows + index * sorter->schema->row_size;
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+    const SortEntry* entry_a = a;
+    const SortEntry* entry_b = b;
+    return compare_rows(sort_context,
+            sorter_row(sort_context, entry_a->index),
+            sorter_row(sort_context, entry_b->index));
+}
+
+// LSD radix sort of the entries on their prefix, one byte per pass.
+// Passes where every entry has the same byte are skipped, so integer
+// keys only take 4 passes.
+static void radix_sort(Sorter* sorter, uint32_t count)
+{
+    uint32_t histogram[sizeof(uint64_t)][256] = {0};
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t prefix = sorter->entries[i].prefix;
+        for (uint32_t byte = 0; byte < sizeof(uint64_t); byte++)
+        {
+            histogram[byte][(prefix >> (byte * 8)) & 0xff] += 1;
+        }
+    }
+
+    for (uint32_t byte = 0; byte < sizeof(uint64_t); byte++)
+    {
+        uint32_t* buckets = histogram[byte];
+        uint32_t shift = byte * 8;
+
+        if (buckets[(sorter->entries[0].prefix >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+
+        // turn the counts into starting positions
+        uint32_t position = 0;
+        for (uint32_t bucket = 0; bucket < 256; bucket++)
+        {
+            uint32_t bucket_count = buckets[bucket];
+            buckets[bucket] = position;
+            position += bucket_count;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            SortEntry entry = sorter->entries[i];
+            sorter->scratch_entries[buckets[(entry.prefix >> shift) & 0xff]++] = entry;
+        }
+
+        SortEntry* sorted = sorter->scratch_entries;
+        sorter->scratch_entries = sorter->entries;
+        sorter->entries = sorted;
+    }
+}
+
+// function to sort the rows held in memory. Afterwards entries lists
+// them in order.
+static void sort_in_memory(Sorter* sorter)
+{
+    uint32_t count = sorter->row_count;
+    if (count == 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sorter->entries[i].prefix = key_prefix(sorter, sorter_row(sorter, i));
+        sorter->entries[i].index = i;
+    }
+
+    radix_sort(sorter, count);
+
+    // text longer than the prefix can still be out of order among rows
+    // that share a prefix
+    if (sorter->column->type == COLUMN_TEXT && sorter->column->size > sizeof(uint64_t))
+    {
+        sort_context = sorter;
+        uint32_t start = 0;
+        for (uint32_t i = 1; i <= count; i++)
+        {
+            if (i == count || sorter->entries[i].prefix != sorter->entries[start].prefix)
+            {
+                if (i - start > 1)
+                {
+                    qsort(sorter->entries + start, i - start, sizeof(SortEntry), compare_entries);
+                }
+                start = i;
+            }
+        }
+        sort_context = NULL;
+    }
+}
+
+/*
+ * ---------------- SPILLED RUNS ---------------------------------------
+ */
+
+static void run_append(Sorter* sorter, SortRun* run, void* row)
+{
+    Schema* schema = sorter->schema;
+    uint32_t page_num = run->row_count / schema->rows_per_page;
+    uint32_t slot = run->row_count % schema->rows_per_page;
+
+    void* page = get_page(run->pager, page_num);
+    memcpy(page + slot * schema->row_size, row, schema->row_size);
+    run->row_count += 1;
+
+    // only one page of the run is ever held in memory
+    if (run->row_count % schema->rows_per_page == 0)
+    {
+        pager_flush(run->pager, page_num);
+        pager_release_page(run->pager, page_num);
+    }
+}
+
+static void run_finish(Sorter* sorter, SortRun* run)
+{
+    Schema* schema = sorter->schema;
+    if (run->row_count % schema->rows_per_page != 0)
+    {
+        uint32_t page_num = run->row_count / schema->rows_per_page;
+        pager_flush(run->pager, page_num);
+        pager_release_page(run->pager, page_num);
+    }
+}
+
+static void* run_current(Sorter* sorter, SortRun* run)
+{
+    Schema* schema = sorter->schema;
+    void* page = get_page(run->pager, run->next_row / schema->rows_per_page);
+    return page + (run->next_row % schema->rows_per_page) * schema->row_size;
+}
+
+static void run_advance(Sorter* sorter, SortRun* run)
+{
+    uint32_t rows_per_page = sorter->schema->rows_per_page;
+    run->next_row += 1;
+
+    // done with the page we were reading from
+    if (run->next_row % rows_per_page == 0 || run->next_row == run->row_count)
+    {
+        pager_release_page(run->pager, (run->next_row - 1) / rows_per_page);
+    }
+}
+
+static SortRun* new_run(Sorter* sorter)
+{
+    sorter->runs = realloc(sorter->runs, (sorter->run_count + 1) * sizeof(SortRun));
+    SortRun* run = &(sorter->runs[sorter->run_count]);
+    run->pager = pager_open_temporary();
+    run->row_count = 0;
+    run->next_row = 0;
+    sorter->run_count += 1;
+    return run;
+}
+
+// function to sort the rows in memory and write them out as a run,
+// leaving the memory free for the next rows
+static void spill_run(Sorter* sorter)
+{
+    sort_in_memory(sorter);
+
+    SortRun* run = new_run(sorter);
+    for (uint32_t i = 0; i < sorter->row_count; i++)
+    {
+        run_append(sorter, run, sorter_row(sorter, sorter->entries[i].index));
+    }
+    run_finish(sorter, run);
+
+    sorter->row_count = 0;
+}
+
+/*
+ * ---------------- K-WAY MERGE ----------------------------------------
+ * A min-heap of runs, ordered by the row each one is positioned on.
+ */
+
+static int compare_runs(Sorter* sorter, uint32_t a, uint32_t b)
+{
+    return compare_rows(sorter,
+            run_current(sorter, &(sorter->runs[a])),
+            run_current(sorter, &(sorter->runs[b])));
+}
+
+static void merge_sift_down(Sorter* sorter, uint32_t position)
+{
+    uint32_t* heap = sorter->merge_heap;
+    uint32_t size = sorter->merge_heap_size;
+
+    while (true)
+    {
+        uint32_t smallest = position;
+        uint32_t left = 2 * position + 1;
+        uint32_t right = left + 1;
+
+        if (left < size && compare_runs(sorter, heap[left], heap[smallest]) < 0)
+        {
+            smallest = left;
+        }
+        if (right < size && compare_runs(sorter, heap[right], heap[smallest]) < 0)
+        {
+            smallest = right;
+        }
+        if (smallest == position)
+        {
+            return;
+        }
+
+        uint32_t swap = heap[position];
+        heap[position] = heap[smallest];
+        heap[smallest] = swap;
+        position = smallest;
+    }
+}
+
+// function to start merging the runs in [first, last)
+static void merge_begin(Sorter* sorter, uint32_t first, uint32_t last)
+{
+    sorter->merge_heap_size = 0;
+    sorter->pending_run = -1;
+
+    for (uint32_t i = first; i < last; i++)
+    {
+        if (sorter->runs[i].row_count > 0)
+        {
+            sorter->merge_heap[sorter->merge_heap_size++] = i;
+        }
+    }
+
+    for (uint32_t i = sorter->merge_heap_size / 2; i-- > 0;)
+    {
+        merge_sift_down(sorter, i);
+    }
+}
+
+// function to get the run holding the next row of the merge, or -1
+// once every run is exhausted. The run stays positioned on that row
+// until the next call, so the row can be used in place.
+static int32_t merge_next(Sorter* sorter)
+{
+    if (sorter->pending_run != -1)
+    {
+        SortRun* run = &(sorter->runs[sorter->pending_run]);
+        run_advance(sorter, run);
+
+        if (run->next_row == run->row_count)
+        {
+            sorter->merge_heap_size -= 1;
+            sorter->merge_heap[0] = sorter->merge_heap[sorter->merge_heap_size];
+        }
+        merge_sift_down(sorter, 0);
+        sorter->pending_run = -1;
+    }
+
+    if (sorter->merge_heap_size == 0)
+    {
+        return -1;
+    }
+
+    sorter->pending_run = sorter->merge_heap[0];
+    return sorter->pending_run;
+}
+
+static void close_runs(Sorter* sorter, uint32_t first, uint32_t last)
+{
+    for (uint32_t i = first; i < last; i++)
+    {
+        pager_close(sorter->runs[i].pager);
+        sorter->runs[i].pager = NULL;
+    }
+}
+
+/*
+ * ---------------- TOP-K ----------------------------------------------
+ * A max-heap over the rows in memory, so the worst of the best k rows
+ * is always at the root, ready to be replaced.
+ */
+
+static void top_k_sift_up(Sorter* sorter, uint32_t position)
+{
+    SortEntry* heap = sorter->entries;
+    while (position > 0)
+    {
+        uint32_t parent = (position - 1) / 2;
+        if (compare_rows(sorter, sorter_row(sorter, heap[position].index),
+                    sorter_row(sorter, heap[parent].index)) <= 0)
+        {
+            return;
+        }
+        SortEntry swap = heap[position];
+        heap[position] = heap[parent];
+        heap[parent] = swap;
+        position = parent;
+    }
+}
+
+static void top_k_sift_down(Sorter* sorter, uint32_t position)
+{
+    SortEntry* heap = sorter->entries;
+    uint32_t size = sorter->row_count;
+
+    while (true)
+    {
+        uint32_t largest = position;
+        uint32_t left = 2 * position + 1;
+        uint32_t right = left + 1;
+
+        if (left < size && compare_rows(sorter, sorter_row(sorter, heap[left].index),
+                    sorter_row(sorter, heap[largest].index)) > 0)
+        {
+            largest = left;
+        }
+        if (right < size && compare_rows(sorter, sorter_row(sorter, heap[right].index),
+                    sorter_row(sorter, heap[largest].index)) > 0)
+        {
+            largest = right;
+        }
+        if (largest == position)
+        {
+            return;
+        }
+
+        SortEntry swap = heap[position];
+        heap[position] = heap[largest];
+        heap[largest] = swap;
+        position = largest;
+    }
+}
+
+static void top_k_add(Sorter* sorter, void* row)
+{
+    uint32_t row_size = sorter->schema->row_size;
+
+    if (sorter->row_count < sorter->limit)
+    {
+        memcpy(sorter_row(sorter, sorter->row_count), row, row_size);
+        sorter->entries[sorter->row_count].index = sorter->row_count;
+        sorter->row_count += 1;
+        top_k_sift_up(sorter, sorter->row_count - 1);
+        return;
+    }
+
+    // replace the worst row we're holding if this one beats it
+    void* worst = sorter_row(sorter, sorter->entries[0].index);
+    if (compare_rows(sorter, row, worst) < 0)
+    {
+        memcpy(worst, row, row_size);
+        top_k_sift_down(sorter, 0);
+    }
+}
+
+/*
+ * ---------------- SORTER ---------------------------------------------
+ */
+
+void sorter_init(Sorter* sorter, Schema* schema, uint32_t column, bool descending, uint32_t limit)
+{
+    sorter->schema = schema;
+    sorter->column = &(schema->columns[column]);
+    sorter->descending = descending;
+    sorter->limit = limit;
+
+    sorter->row_capacity = SORT_MEMORY_PAGES * schema->rows_per_page;
+    sorter->row_count = 0;
+    sorter->rows = malloc(SORT_MEMORY_PAGES * PAGE_SIZE);
+    sorter->entries = malloc(sorter->row_capacity * sizeof(SortEntry));
+    sorter->scratch_entries = malloc(sorter->row_capacity * sizeof(SortEntry));
+
+    // LIMIT k only needs the k best rows, never a full sort
+    sorter->is_top_k = limit <= sorter->row_capacity;
+
+    sorter->runs = NULL;
+    sorter->run_count = 0;
+    sorter->first_run = 0;
+
+    sorter->rows_returned = 0;
+    sorter->merge_heap = malloc(SORT_MERGE_FANIN * sizeof(uint32_t));
+    sorter->merge_heap_size = 0;
+    sorter->pending_run = -1;
+}
+
+void sorter_add(Sorter* sorter, void* row)
+{
+    if (sorter->is_top_k)
+    {
+        if (sorter->limit > 0)
+        {
+            top_k_add(sorter, row);
+        }
+        return;
+    }
+
+    if (sorter->row_count == sorter->row_capacity)
+    {
+        spill_run(sorter);
+    }
+
+    memcpy(sorter_row(sorter, sorter->row_count), row, sorter->schema->row_size);
+    sorter->row_count += 1;
+}
+
+void sorter_finish(Sorter* sorter)
+{
+    if (sorter->run_count == 0)
+    {
+        // everything fit in memory
+        sort_in_memory(sorter);
+        return;
+    }
+
+    if (sorter->row_count > 0)
+    {
+        spill_run(sorter);
+    }
+
+    // merge groups of runs into longer runs until they can all be
+    // merged at once
+    while (sorter->run_count - sorter->first_run > SORT_MERGE_FANIN)
+    {
+        uint32_t first = sorter->first_run;
+        uint32_t last = first + SORT_MERGE_FANIN;
+
+        SortRun* merged = new_run(sorter);
+        merge_begin(sorter, first, last);
+
+        int32_t run;
+        while ((run = merge_next(sorter)) != -1)
+        {
+            run_append(sorter, merged, run_current(sorter, &(sorter->runs[run])));
+        }
+        run_finish(sorter, merged);
+
+        close_runs(sorter, first, last);
+        sorter->first_run = last;
+    }
+
+    merge_begin(sorter, sorter->first_run, sorter->run_count);
+}
+
+// function to get the next row in order, or NULL once the sort (or
+// its LIMIT) is exhausted. The row is only valid until the next call.
+void* sorter_next(Sorter* sorter)
+{
+    if (sorter->rows_returned >= sorter->limit)
+    {
+        return NULL;
+    }
+
+    void* row = NULL;
+    if (sorter->run_count == 0)
+    {
+        if (sorter->rows_returned < sorter->row_count)
+        {
+            row = sorter_row(sorter, sorter->entries[sorter->rows_returned].index);
+        }
+    }
+    else
+    {
+        int32_t run = merge_next(sorter);
+        if (run != -1)
+        {
+            row = run_current(sorter, &(sorter->runs[run]));
+        }
+    }
+
+    if (row != NULL)
+    {
+        sorter->rows_returned += 1;
+    }
+    return row;
+}
+
+void sorter_close(Sorter* sorter)
+{
+    close_runs(sorter, sorter->first_run, sorter->run_count);
+    free(sorter->runs);
+    free(sorter->rows);
+    free(sorter->entries);
+    free(sorter->scratch_entries);
+    free(sorter->merge_heap);
+}
@@ -0,0 +1,22 @@
+/*
+ * SORT
+ * -----------
+ *  This file contains the utilities to order the rows of a select,
+ *  including but not limited to
+ *  1. Sorting rows in memory on a packed key prefix (radix sort)
+ *  2. Spilling sorted runs to scratch files through the pager
+ *  3. Merging the runs back together, k at a time
+ *  4. Keeping only the best rows for a LIMIT (top-k heap)
+ */
+#ifndef sort_h
+#define sort_h
+
+#include "globals.h"
+
+void sorter_init(Sorter* sorter, Schema* schema, uint32_t column, bool descending, uint32_t limit);
+void sorter_add(Sorter* sorter, void* row);
+void sorter_finish(Sorter* sorter);
+void* sorter_next(Sorter* sorter);
+void sorter_close(Sorter* sorter);
+
+#endif
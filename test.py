@@ -1,7 +1,10 @@
 # testing script for Hyperion
 from typing import List, Tuple
+import os
+import tempfile
 import unittest
 from subprocess import run, PIPE
+import struct
 
 DATABASE_RAW_COMMAND = "./hyperion"
 
@@ -17,16 +20,27 @@ def decompose_output_from_program(output_string):
     return [str(x) for x in output_string.split("\n")]
 
 
-def run_test_commands(commands):
-    # takes the string of commands, runs them all and returns
-    # stdout
-    output = run([DATABASE_RAW_COMMAND], stdout=PIPE, input=commands, encoding="ascii")
+def temporary_database_path():
+    # returns a path to a fresh database file that doesn't exist yet
+    return os.path.join(tempfile.mkdtemp(), "test.db")
+
+
+def run_test_commands(commands, database=None):
+    # takes the string of commands, runs them all against the database
+    # (a fresh one unless specified) and returns stdout
+    if database is None:
+        database = temporary_database_path()
+    output = run(
+        [DATABASE_RAW_COMMAND, database], stdout=PIPE, input=commands, encoding="ascii"
+    )
     return (output.returncode, output.stdout)
 
 
-def validate_test(command_list, target_output_list):
+def validate_test(command_list, target_output_list, database=None):
     # returns a boolean with the status of the commands to be run
-    return_code, stdout = run_test_commands(get_commands_from_array(command_list))
+    return_code, stdout = run_test_commands(
+        get_commands_from_array(command_list), database
+    )
     print(stdout, return_code)
     if return_code != 0:
         print(f"Failed with {return_code}")
@@ -40,6 +54,53 @@ def validate_test(command_list, target_output_list):
         return output_list == target_output_list
 
 
+def read_columnar_stream(data):
+    # decodes a columnar result stream into (column names, rows)
+    position = 0
+    names, types, rows = [], [], []
+
+    while True:
+        marker, metadata_length = struct.unpack_from("<II", data, position)
+        position += 8
+        assert marker == 0xFFFFFFFF
+        if metadata_length == 0:
+            return (names, rows)
+        metadata = data[position : position + metadata_length]
+        position += metadata_length
+
+        if struct.unpack_from("<I", metadata)[0] == 1:
+            # schema
+            (column_count,) = struct.unpack_from("<I", metadata, 4)
+            field = 8
+            for _ in range(column_count):
+                column_type, _, name_length = struct.unpack_from("<III", metadata, field)
+                field += 12
+                names.append(metadata[field : field + name_length].decode())
+                types.append(column_type)
+                field += (name_length + 3) // 4 * 4
+            continue
+
+        # record batch
+        buffer_count, row_count = struct.unpack_from("<IQ", metadata, 4)
+        buffers = []
+        for i in range(buffer_count):
+            offset, length = struct.unpack_from("<QQ", metadata, 16 + 16 * i)
+            buffers.append(data[position + offset : position + offset + length])
+        position += sum((len(b) + 7) // 8 * 8 for b in buffers)
+
+        columns = []
+        for column_type in types:
+            if column_type == 2:
+                columns.append(list(struct.unpack(f"<{row_count}I", buffers.pop(0))))
+            else:
+                offsets = struct.unpack(f"<{row_count + 1}I", buffers.pop(0))
+                text = buffers.pop(0)
+                columns.append(
+                    [text[offsets[r] : offsets[r + 1]].decode() for r in range(row_count)]
+                )
+        rows += list(zip(*columns))
+
+
 class BasicTest(unittest.TestCase):
     # sanity checks
     def test_basic_prompt(self):
@@ -68,5 +129,277 @@ class QueryTest(unittest.TestCase):
         self.assertFalse(validate_test(queryset, []))
 
 
+class OrderByTest(unittest.TestCase):
+    def test_order_by_spills_to_disk(self):
+        # enough rows to overflow the in-memory sort budget, so the
+        # result comes out of a merge of spilled runs. That's 5 runs,
+        # more than SORT_MERGE_FANIN, so they take two merge passes
+        ids = [(x * 7919) % 1000 for x in range(1, 1001)]
+        queryset = [f"insert {x} user{x} user{x}@x.com" for x in ids]
+        queryset += ["select order by id desc", ".exit"]
+        expected = ["H > Executed"] * len(ids)
+        rows = [f"({x}, user{x}, user{x}@x.com)" for x in sorted(ids, reverse=True)]
+        expected += ["H > " + rows[0]] + rows[1:] + ["Executed", "H > "]
+        self.assertTrue(validate_test(queryset, expected))
+
+    def test_order_by_limit(self):
+        # a LIMIT only keeps the best rows
+        self.assertTrue(
+            validate_test(
+                [
+                    "insert 3 c c@x.com",
+                    "insert 1 b b@x.com",
+                    "insert 2 a a@x.com",
+                    "select order by username limit 2",
+                    ".exit",
+                ],
+                [
+                    "H > Executed",
+                    "H > Executed",
+                    "H > Executed",
+                    "H > (2, a, a@x.com)",
+                    "(1, b, b@x.com)",
+                    "Executed",
+                    "H > ",
+                ],
+            )
+        )
+
+
+class LimitOffsetTest(unittest.TestCase):
+    def test_limit_offset(self):
+        # the scan starts at the offset and stops at the limit, across
+        # a page boundary
+        queryset = [f"insert {x} user{x} user{x}@x.com" for x in range(1, 31)]
+        queryset += ["select limit 3 offset 12", ".exit"]
+        expected = ["H > Executed"] * 30
+        expected += [
+            "H > (13, user13, user13@x.com)",
+            "(14, user14, user14@x.com)",
+            "(15, user15, user15@x.com)",
+            "Executed",
+            "H > ",
+        ]
+        self.assertTrue(validate_test(queryset, expected))
+
+    def test_limit_and_offset_must_be_counts(self):
+        # a LIMIT or OFFSET that isn't a plain count is a syntax error,
+        # rather than being read as 0 or wrapped around
+        error = [
+            "H > Syntax Error: Could not Parse Statement",
+            "Unrecognized Keyword at the start of 'select'",
+        ]
+        self.assertTrue(
+            validate_test(
+                [
+                    "insert 1 A abc@amail.com",
+                    "select limit abc",
+                    "select limit 1x",
+                    "select limit -1",
+                    "select limit 4294967296",
+                    "select offset abc",
+                    "select offset -1",
+                    "select limit 1 offset 1x",
+                    "select limit 1",
+                    ".exit",
+                ],
+                ["H > Executed"]
+                + error * 7
+                + ["H > (1, A, abc@amail.com)", "Executed", "H > "],
+            )
+        )
+
+class CatalogTest(unittest.TestCase):
+    def test_create_table_persists(self):
+        # tables created with CREATE TABLE live next to the default
+        # table and survive a restart
+        database = temporary_database_path()
+        self.assertTrue(
+            validate_test(
+                [
+                    "create table pets (id int, name varchar(8))",
+                    "insert into pets 7 rex",
+                    "insert 1 A abc@amail.com",
+                    ".exit",
+                ],
+                ["H > Executed", "H > Executed", "H > Executed", "H > "],
+                database,
+            )
+        )
+        self.assertTrue(
+            validate_test(
+                ["select * from pets", "select", ".exit"],
+                [
+                    "H > (7, rex)",
+                    "Executed",
+                    "H > (1, A, abc@amail.com)",
+                    "Executed",
+                    "H > ",
+                ],
+                database,
+            )
+        )
+
+
+class ChecksumTest(unittest.TestCase):
+    def test_corrupt_page_detected(self):
+        # flipping a byte of a data page is caught when it's loaded
+        database = temporary_database_path()
+        self.assertTrue(
+            validate_test(["insert 1 A abc@amail.com", ".exit"], ["H > Executed", "H > "], database)
+        )
+        with open(database, "r+b") as database_file:
+            database_file.seek(4096 + 8)
+            database_file.write(b"Z")
+        return_code, stdout = run_test_commands(
+            get_commands_from_array(["select", ".exit"]), database
+        )
+        self.assertNotEqual(return_code, 0)
+        self.assertIn("Page 1 is corrupt", stdout)
+
+    def test_foreign_file_rejected(self):
+        # a file that isn't a database is reported as such, not as corrupt
+        database = temporary_database_path()
+        with open(database, "wb") as database_file:
+            database_file.write(bytes(range(256)) * 32)
+        return_code, stdout = run_test_commands(
+            get_commands_from_array([".exit"]), database
+        )
+        self.assertNotEqual(return_code, 0)
+        self.assertEqual(stdout, "Not a Hyperion database.\n")
+
+
+class ColumnarOutputTest(unittest.TestCase):
+    def test_columnar_select(self):
+        # results written in columnar mode decode back to the same rows,
+        # across more than one record batch
+        output = temporary_database_path()
+        queryset = [f"insert {x} user{x} user{x}@x.com" for x in range(1, 1201)]
+        queryset += [f".mode arrow {output}", "select offset 5", ".mode text", ".exit"]
+        expected = ["H > Executed"] * 1200 + ["H > H > Executed", "H > H > "]
+        self.assertTrue(validate_test(queryset, expected))
+
+        with open(output, "rb") as output_file:
+            names, rows = read_columnar_stream(output_file.read())
+        self.assertEqual(names, ["id", "username", "email"])
+        self.assertEqual(
+            rows, [(x, f"user{x}", f"user{x}@x.com") for x in range(6, 1201)]
+        )
+
+
+    def test_columnar_output_never_targets_the_database(self):
+        # neither the database's descriptor nor its path can take results
+        database = temporary_database_path()
+        self.assertTrue(
+            validate_test(
+                [
+                    "insert 1 A abc@amail.com",
+                    ".mode arrow 3",
+                    f".mode arrow {database}",
+                    "select",
+                    ".exit",
+                ],
+                [
+                    "H > Executed",
+                    "H > Error: Could not Open the Output!",
+                    "H > Error: Could not Open the Output!",
+                    "H > (1, A, abc@amail.com)",
+                    "Executed",
+                    "H > ",
+                ],
+                database,
+            )
+        )
+        self.assertTrue(
+            validate_test(
+                ["select", ".exit"],
+                ["H > (1, A, abc@amail.com)", "Executed", "H > "],
+                database,
+            )
+        )
+
+    def test_columnar_select_to_stdout(self):
+        # with no target the stream has stdout to itself: the prompt and
+        # status text move to stderr until text mode is back
+        commands = [
+            "insert 1 A abc@amail.com",
+            ".mode arrow",
+            "select",
+            ".mode text",
+            "select",
+            ".exit",
+        ]
+        output = run(
+            [DATABASE_RAW_COMMAND, temporary_database_path()],
+            stdout=PIPE,
+            stderr=PIPE,
+            input=get_commands_from_array(commands).encode("ascii"),
+        )
+        self.assertEqual(output.returncode, 0)
+
+        text_before = b"H > Executed\nH > "
+        text_after = b"H > (1, A, abc@amail.com)\nExecuted\nH > "
+        self.assertTrue(output.stdout.startswith(text_before))
+        self.assertTrue(output.stdout.endswith(text_after))
+        names, rows = read_columnar_stream(
+            output.stdout[len(text_before) : -len(text_after)]
+        )
+        self.assertEqual(names, ["id", "username", "email"])
+        self.assertEqual(rows, [(1, "A", "abc@amail.com")])
+        self.assertEqual(output.stderr, b"H > Executed\nH > ")
+
+
+class BackupTest(unittest.TestCase):
+    def test_backup_snapshot(self):
+        # the backup holds the rows present when .backup ran, and the
+        # engine keeps accepting inserts while it is written
+        database = temporary_database_path()
+        backup = temporary_database_path()
+        self.assertTrue(
+            validate_test(
+                [
+                    "insert 1 A abc@amail.com",
+                    f".backup {backup}",
+                    "insert 2 B bcd@amail.com",
+                    ".exit",
+                ],
+                ["H > Executed", "H > H > Executed", "H > "],
+                database,
+            )
+        )
+        self.assertTrue(
+            validate_test(
+                ["select", ".exit"],
+                ["H > (1, A, abc@amail.com)", "Executed", "H > "],
+                backup,
+            )
+        )
+
+
+    def test_backup_onto_itself_refused(self):
+        # backing up onto the open database must not truncate it
+        database = temporary_database_path()
+        self.assertTrue(
+            validate_test(
+                ["insert 1 A abc@amail.com", f".backup {database}", "select", ".exit"],
+                [
+                    "H > Executed",
+                    "H > Cannot back up the database onto itself.",
+                    "Error: Backup Failed!",
+                    "H > (1, A, abc@amail.com)",
+                    "Executed",
+                    "H > ",
+                ],
+                database,
+            )
+        )
+        self.assertTrue(
+            validate_test(
+                ["select", ".exit"],
+                ["H > (1, A, abc@amail.com)", "Executed", "H > "],
+                database,
+            )
+        )
+
 if __name__ == "__main__":
     unittest.main()